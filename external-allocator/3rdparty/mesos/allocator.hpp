@@ -19,13 +19,23 @@
 #ifndef __MASTER_ALLOCATOR_MESOS_ALLOCATOR_HPP__
 #define __MASTER_ALLOCATOR_MESOS_ALLOCATOR_HPP__
 
+#include <random>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
 #include <mesos/master/allocator.hpp>
 
 #include <process/dispatch.hpp>
 #include <process/process.hpp>
 
+#include <stout/error.hpp>
+#include <stout/option.hpp>
 #include <stout/try.hpp>
 
+#include "mesos/flags.hpp"
+#include "mesos/trace.hpp"
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -33,6 +43,17 @@ namespace allocator {
 
 class MesosAllocatorProcess;
 
+
+// Resources recovered from a framework on a slave, e.g. those of a
+// declined offer or of a completed task.
+struct RecoveredResources
+{
+  FrameworkID frameworkId;
+  SlaveID slaveId;
+  Resources resources;
+  Option<Filters> filters;
+};
+
 // A wrapper for Process-based allocators. It redirects all function
 // invocations to the underlying AllocatorProcess and manages its
 // lifetime. We ensure the template parameter AllocatorProcess
@@ -44,6 +65,12 @@ public:
   // Factory to allow for typed tests.
   static Try<mesos::master::allocator::Allocator*> create();
 
+  // Factory for an allocator tuned with the given flags. If a trace
+  // file is given, every call is additionally recorded to it, see
+  // 'trace::Writer'.
+  static Try<mesos::master::allocator::Allocator*> create(
+      const Flags& flags);
+
   ~MesosAllocator();
 
   void initialize(
@@ -103,12 +130,71 @@ public:
   void reviveOffers(
       const FrameworkID& frameworkId);
 
+  // Recovers many resources at once, e.g. all offers a framework
+  // declined in one go, in a single message to the allocator. Not
+  // part of the 'Allocator' interface, hence only available to
+  // callers aware of 'MesosAllocator'.
+  void bulkRecoverResources(
+      const std::vector<RecoveredResources>& recovered);
+
+  // Stops offers to the framework until it revives offers. Not part
+  // of the 'Allocator' interface either.
+  void suppressOffers(
+      const FrameworkID& frameworkId);
+
+  // Adds a role at runtime, as if it had been passed to 'initialize'.
+  // Roles that exist already are ignored. Not part of the 'Allocator'
+  // interface either.
+  void addRole(
+      const std::string& role,
+      const mesos::master::RoleInfo& roleInfo);
+
+  // Removes a role without any frameworks. Not part of the
+  // 'Allocator' interface either.
+  void removeRole(
+      const std::string& role);
+
+  // Updates the weights of the given roles. Not part of the
+  // 'Allocator' interface either.
+  void updateWeights(
+      const std::vector<mesos::master::RoleInfo>& roleInfos);
+
+  // Guarantees the role the given resources, replacing its previous
+  // quota, if any. Not part of the 'Allocator' interface either.
+  void setQuota(
+      const std::string& role,
+      const Resources& guarantee);
+
+  // Removes the quota of the role. Not part of the 'Allocator'
+  // interface either.
+  void removeQuota(
+      const std::string& role);
+
+  // Updates the estimate of the slave's revocable resources, i.e.,
+  // of resources allocated but idle, which are offered to frameworks
+  // opted in for revocable resources. Not part of the 'Allocator'
+  // interface either.
+  void updateSlave(
+      const SlaveID& slaveId,
+      const Resources& oversubscribed);
+
+  // Sets the framework's placement constraints: ';' separated
+  // 'name:value' attributes, e.g. "rack:r1;os:linux", all of which a
+  // slave must have to be offered to the framework. Empty constraints
+  // allow every slave. Not part of the 'Allocator' interface either.
+  void updateConstraints(
+      const FrameworkID& frameworkId,
+      const std::string& constraints);
+
 private:
-  MesosAllocator();
+  explicit MesosAllocator(const Flags& flags);
   MesosAllocator(const MesosAllocator&); // Not copyable.
   MesosAllocator& operator=(const MesosAllocator&); // Not assignable.
 
   MesosAllocatorProcess* process;
+
+  // Records calls if tracing is enabled, NULL otherwise.
+  trace::Writer* tracer;
 };
 
 
@@ -180,6 +266,52 @@ public:
 
   virtual void reviveOffers(
       const FrameworkID& frameworkId) = 0;
+
+  virtual void bulkRecoverResources(
+      const std::vector<RecoveredResources>& recovered) = 0;
+
+  virtual void suppressOffers(
+      const FrameworkID& frameworkId) = 0;
+
+  virtual void addRole(
+      const std::string& role,
+      const mesos::master::RoleInfo& roleInfo) = 0;
+
+  virtual void removeRole(
+      const std::string& role) = 0;
+
+  virtual void updateWeights(
+      const std::vector<mesos::master::RoleInfo>& roleInfos) = 0;
+
+  virtual void setQuota(
+      const std::string& role,
+      const Resources& guarantee) = 0;
+
+  virtual void removeQuota(
+      const std::string& role) = 0;
+
+  virtual void updateSlave(
+      const SlaveID& slaveId,
+      const Resources& oversubscribed) = 0;
+
+  virtual void updateConstraints(
+      const FrameworkID& frameworkId,
+      const std::string& constraints) = 0;
+
+  // Check that 'updateAllocation' and 'recoverResources' respectively
+  // can be applied, i.e. that the framework holds the resources they
+  // refer to. Replays call these first, since a replayed allocator
+  // that made other offers than the recorded one would otherwise
+  // abort or corrupt its state, see 'trace::replay'.
+  virtual Option<Error> checkUpdateAllocation(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const std::vector<Offer::Operation>& operations) = 0;
+
+  virtual Option<Error> checkRecoverResources(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources) = 0;
 };
 
 
@@ -187,13 +319,49 @@ template <typename AllocatorProcess>
 Try<mesos::master::allocator::Allocator*>
 MesosAllocator<AllocatorProcess>::create()
 {
-  return new MesosAllocator<AllocatorProcess>();
+  return new MesosAllocator<AllocatorProcess>(Flags());
 }
 
+
 template <typename AllocatorProcess>
-MesosAllocator<AllocatorProcess>::MesosAllocator()
+Try<mesos::master::allocator::Allocator*>
+MesosAllocator<AllocatorProcess>::create(const Flags& flags)
 {
-  process = new AllocatorProcess();
+  trace::Writer* tracer = NULL;
+
+  // Traces record the seed of the allocator, so that their replays
+  // make the same offers, hence it is chosen here if not given.
+  Flags seeded = flags;
+
+  if (flags.trace.isSome()) {
+    if (seeded.random_seed.isNone()) {
+      seeded.random_seed = std::random_device()();
+    }
+
+    Try<trace::Writer*> writer =
+      trace::Writer::create(flags.trace.get(), seeded.random_seed.get());
+
+    if (writer.isError()) {
+      return Error(writer.error());
+    }
+
+    tracer = writer.get();
+  }
+
+  MesosAllocator<AllocatorProcess>* allocator =
+    new MesosAllocator<AllocatorProcess>(seeded);
+
+  allocator->tracer = tracer;
+
+  return allocator;
+}
+
+
+template <typename AllocatorProcess>
+MesosAllocator<AllocatorProcess>::MesosAllocator(const Flags& flags)
+  : tracer(NULL)
+{
+  process = new AllocatorProcess(flags);
   process::spawn(process);
 }
 
@@ -204,6 +372,8 @@ MesosAllocator<AllocatorProcess>::~MesosAllocator()
   process::terminate(process);
   process::wait(process);
   delete process;
+
+  delete tracer;
 }
 
 
@@ -215,6 +385,10 @@ inline void MesosAllocator<AllocatorProcess>::initialize(
              const hashmap<SlaveID, Resources>&)>& offerCallback,
     const hashmap<std::string, mesos::master::RoleInfo>& roles)
 {
+  if (tracer != NULL) {
+    tracer->initialize(allocationInterval, roles);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::initialize,
@@ -230,6 +404,10 @@ inline void MesosAllocator<AllocatorProcess>::addFramework(
     const FrameworkInfo& frameworkInfo,
     const hashmap<SlaveID, Resources>& used)
 {
+  if (tracer != NULL) {
+    tracer->addFramework(frameworkId, frameworkInfo, used);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::addFramework,
@@ -243,6 +421,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::removeFramework(
     const FrameworkID& frameworkId)
 {
+  if (tracer != NULL) {
+    tracer->removeFramework(frameworkId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::removeFramework,
@@ -254,6 +436,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::activateFramework(
     const FrameworkID& frameworkId)
 {
+  if (tracer != NULL) {
+    tracer->activateFramework(frameworkId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::activateFramework,
@@ -265,6 +451,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::deactivateFramework(
     const FrameworkID& frameworkId)
 {
+  if (tracer != NULL) {
+    tracer->deactivateFramework(frameworkId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::deactivateFramework,
@@ -279,6 +469,10 @@ inline void MesosAllocator<AllocatorProcess>::addSlave(
     const Resources& total,
     const hashmap<FrameworkID, Resources>& used)
 {
+  if (tracer != NULL) {
+    tracer->addSlave(slaveId, slaveInfo, total, used);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::addSlave,
@@ -293,6 +487,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::removeSlave(
     const SlaveID& slaveId)
 {
+  if (tracer != NULL) {
+    tracer->removeSlave(slaveId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::removeSlave,
@@ -304,6 +502,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::activateSlave(
     const SlaveID& slaveId)
 {
+  if (tracer != NULL) {
+    tracer->activateSlave(slaveId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::activateSlave,
@@ -315,6 +517,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::deactivateSlave(
     const SlaveID& slaveId)
 {
+  if (tracer != NULL) {
+    tracer->deactivateSlave(slaveId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::deactivateSlave,
@@ -326,6 +532,10 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::updateWhitelist(
     const Option<hashset<std::string> >& whitelist)
 {
+  if (tracer != NULL) {
+    tracer->updateWhitelist(whitelist);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::updateWhitelist,
@@ -338,6 +548,10 @@ inline void MesosAllocator<AllocatorProcess>::requestResources(
     const FrameworkID& frameworkId,
     const std::vector<Request>& requests)
 {
+  if (tracer != NULL) {
+    tracer->requestResources(frameworkId, requests);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::requestResources,
@@ -352,6 +566,10 @@ inline void MesosAllocator<AllocatorProcess>::updateAllocation(
     const SlaveID& slaveId,
     const std::vector<Offer::Operation>& operations)
 {
+  if (tracer != NULL) {
+    tracer->updateAllocation(frameworkId, slaveId, operations);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::updateAllocation,
@@ -368,6 +586,10 @@ inline void MesosAllocator<AllocatorProcess>::recoverResources(
     const Resources& resources,
     const Option<Filters>& filters)
 {
+  if (tracer != NULL) {
+    tracer->recoverResources(frameworkId, slaveId, resources, filters);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::recoverResources,
@@ -382,12 +604,159 @@ template <typename AllocatorProcess>
 inline void MesosAllocator<AllocatorProcess>::reviveOffers(
     const FrameworkID& frameworkId)
 {
+  if (tracer != NULL) {
+    tracer->reviveOffers(frameworkId);
+  }
+
   process::dispatch(
       process,
       &MesosAllocatorProcess::reviveOffers,
       frameworkId);
 }
 
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::bulkRecoverResources(
+    const std::vector<RecoveredResources>& recovered)
+{
+  if (tracer != NULL) {
+    tracer->bulkRecoverResources(recovered);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::bulkRecoverResources,
+      recovered);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::suppressOffers(
+    const FrameworkID& frameworkId)
+{
+  if (tracer != NULL) {
+    tracer->suppressOffers(frameworkId);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::suppressOffers,
+      frameworkId);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::addRole(
+    const std::string& role,
+    const mesos::master::RoleInfo& roleInfo)
+{
+  if (tracer != NULL) {
+    tracer->addRole(role, roleInfo);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::addRole,
+      role,
+      roleInfo);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::removeRole(
+    const std::string& role)
+{
+  if (tracer != NULL) {
+    tracer->removeRole(role);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::removeRole,
+      role);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::updateWeights(
+    const std::vector<mesos::master::RoleInfo>& roleInfos)
+{
+  if (tracer != NULL) {
+    tracer->updateWeights(roleInfos);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::updateWeights,
+      roleInfos);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::setQuota(
+    const std::string& role,
+    const Resources& guarantee)
+{
+  if (tracer != NULL) {
+    tracer->setQuota(role, guarantee);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::setQuota,
+      role,
+      guarantee);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::removeQuota(
+    const std::string& role)
+{
+  if (tracer != NULL) {
+    tracer->removeQuota(role);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::removeQuota,
+      role);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::updateSlave(
+    const SlaveID& slaveId,
+    const Resources& oversubscribed)
+{
+  if (tracer != NULL) {
+    tracer->updateSlave(slaveId, oversubscribed);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::updateSlave,
+      slaveId,
+      oversubscribed);
+}
+
+
+template <typename AllocatorProcess>
+inline void MesosAllocator<AllocatorProcess>::updateConstraints(
+    const FrameworkID& frameworkId,
+    const std::string& constraints)
+{
+  if (tracer != NULL) {
+    tracer->updateConstraints(frameworkId, constraints);
+  }
+
+  process::dispatch(
+      process,
+      &MesosAllocatorProcess::updateConstraints,
+      frameworkId,
+      constraints);
+}
+
 } // namespace allocator {
 } // namespace master {
 } // namespace internal {
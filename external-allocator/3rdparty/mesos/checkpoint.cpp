@@ -0,0 +1,302 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <memory>
+#include <thread>
+
+#include <process/future.hpp>
+
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/none.hpp>
+#include <stout/os.hpp>
+
+#include "mesos/checkpoint.hpp"
+#include "mesos/trace.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace checkpoint {
+
+static string encode(const State& state)
+{
+  trace::Encoder encoder;
+
+  encoder.encode(state.time);
+
+  encoder.encode(static_cast<uint32_t>(state.roles.size()));
+  foreachpair (const string& role, uint64_t allocations, state.roles) {
+    encoder.encode(role);
+    encoder.encode(static_cast<int64_t>(allocations));
+  }
+
+  encoder.encode(static_cast<uint32_t>(state.frameworks.size()));
+  foreachpair (const FrameworkID& frameworkId,
+               const State::Framework& framework,
+               state.frameworks) {
+    encoder.encode(frameworkId);
+    encoder.encode(framework.role);
+    encoder.encode(static_cast<int64_t>(framework.allocations));
+  }
+
+  encoder.encode(static_cast<uint32_t>(state.slaves.size()));
+  foreachpair (const SlaveID& slaveId,
+               const State::Slave& slave,
+               state.slaves) {
+    encoder.encode(slaveId);
+    encoder.encode(slave.hostname);
+    encoder.encode(slave.total);
+  }
+
+  return encoder.data();
+}
+
+
+static Try<State> decode(const char* data, size_t size)
+{
+  trace::Decoder decoder(data, size);
+
+  State state;
+  uint32_t count;
+
+  if (!decoder.decode(&state.time) || !decoder.decode(&count)) {
+    return Error("Truncated header");
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    string role;
+    int64_t allocations;
+    if (!decoder.decode(&role) || !decoder.decode(&allocations)) {
+      return Error("Malformed role");
+    }
+    state.roles[role] = allocations;
+  }
+
+  if (!decoder.decode(&count)) {
+    return Error("Truncated frameworks");
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    FrameworkID frameworkId;
+    State::Framework framework;
+    int64_t allocations;
+    if (!decoder.decode(&frameworkId) ||
+        !decoder.decode(&framework.role) ||
+        !decoder.decode(&allocations)) {
+      return Error("Malformed framework");
+    }
+    framework.allocations = allocations;
+    state.frameworks[frameworkId] = framework;
+  }
+
+  if (!decoder.decode(&count)) {
+    return Error("Truncated slaves");
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    SlaveID slaveId;
+    State::Slave slave;
+    if (!decoder.decode(&slaveId) ||
+        !decoder.decode(&slave.hostname) ||
+        !decoder.decode(&slave.total)) {
+      return Error("Malformed slave");
+    }
+    state.slaves[slaveId] = slave;
+  }
+
+  if (!decoder.done()) {
+    return Error("Trailing data");
+  }
+
+  return state;
+}
+
+
+Try<Nothing> write(const string& path, const State& state)
+{
+  const string payload = encode(state);
+
+  Header header;
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.reserved = 0;
+  header.size = payload.size();
+
+  const size_t size = sizeof(header) + payload.size();
+  const string temporary = path + ".tmp";
+
+  Try<int> fd = os::open(
+      temporary,
+      O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (fd.isError()) {
+    return Error(
+        "Failed to open checkpoint file '" + temporary + "': " + fd.error());
+  }
+
+  if (::ftruncate(fd.get(), size) < 0) {
+    ErrnoError error("Failed to resize checkpoint file '" + temporary + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  void* data =
+    ::mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd.get(), 0);
+
+  if (data == MAP_FAILED) {
+    ErrnoError error("Failed to mmap checkpoint file '" + temporary + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  memcpy(data, &header, sizeof(header));
+  memcpy(static_cast<char*>(data) + sizeof(header),
+         payload.data(),
+         payload.size());
+
+  // The checkpoint must be on disk before it replaces the previous
+  // one.
+  if (::msync(data, size, MS_SYNC) < 0) {
+    ErrnoError error("Failed to sync checkpoint file '" + temporary + "'");
+    ::munmap(data, size);
+    os::close(fd.get());
+    return error;
+  }
+
+  ::munmap(data, size);
+  os::close(fd.get());
+
+  if (::rename(temporary.c_str(), path.c_str()) < 0) {
+    return ErrnoError(
+        "Failed to rename checkpoint file '" + temporary + "' to '" +
+        path + "'");
+  }
+
+  return Nothing();
+}
+
+
+static void _save(
+    const string& path,
+    const State& state,
+    const std::shared_ptr<process::Promise<Nothing> >& promise)
+{
+  Try<Nothing> result = write(path, state);
+
+  if (result.isError()) {
+    promise->fail(result.error());
+  } else {
+    promise->set(Nothing());
+  }
+}
+
+
+process::Future<Nothing> save(const string& path, const State& state)
+{
+  std::shared_ptr<process::Promise<Nothing> > promise(
+      new process::Promise<Nothing>());
+
+  // The thread gets a copy of the state, which the caller is free to
+  // change meanwhile.
+  std::thread thread(&_save, path, state, promise);
+  thread.detach();
+
+  return promise->future();
+}
+
+
+Result<State> read(const string& path)
+{
+  if (!os::exists(path)) {
+    return None();
+  }
+
+  Try<int> fd = os::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd.isError()) {
+    return Error(
+        "Failed to open checkpoint file '" + path + "': " + fd.error());
+  }
+
+  struct stat s;
+  if (::fstat(fd.get(), &s) < 0) {
+    ErrnoError error("Failed to stat checkpoint file '" + path + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  size_t size = s.st_size;
+
+  if (size < sizeof(Header)) {
+    os::close(fd.get());
+    return Error("Checkpoint file '" + path + "' is too short");
+  }
+
+  void* data = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+  if (data == MAP_FAILED) {
+    ErrnoError error("Failed to mmap checkpoint file '" + path + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  // The mapping stays valid once the file descriptor is closed.
+  os::close(fd.get());
+
+  const Header* header = static_cast<const Header*>(data);
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION) {
+    ::munmap(data, size);
+    return Error("Checkpoint file '" + path + "' has an unsupported format");
+  }
+
+  if (header->size != size - sizeof(Header)) {
+    ::munmap(data, size);
+    return Error("Checkpoint file '" + path + "' is truncated");
+  }
+
+  Try<State> state =
+    decode(static_cast<const char*>(data) + sizeof(Header), header->size);
+
+  ::munmap(data, size);
+
+  if (state.isError()) {
+    return Error(
+        "Failed to decode checkpoint file '" + path + "': " + state.error());
+  }
+
+  return state.get();
+}
+
+} // namespace checkpoint {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
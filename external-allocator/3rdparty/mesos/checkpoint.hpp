@@ -0,0 +1,112 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_CHECKPOINT_HPP__
+#define __MASTER_ALLOCATOR_MESOS_CHECKPOINT_HPP__
+
+#include <stdint.h>
+
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <process/future.hpp>
+
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/result.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// A checkpoint is a compact binary copy of the allocator state that
+// does not come back with re-registrations after a master failover,
+// e.g. how often the sorters have chosen every role and framework,
+// and of the slaves that are expected to re-register:
+//
+//   checkpoint := header payload[size]
+//   header     := magic[8] version:u32 reserved:u32 size:u64
+//
+// The payload is encoded like the records of a trace, see
+// 'trace::Encoder'. A checkpoint is written to a temporary file which
+// is then renamed, so that a crash never leaves a partial checkpoint
+// behind.
+namespace checkpoint {
+
+const char MAGIC[8] = { 'M', 'E', 'S', 'O', 'S', 'A', 'C', 'K' };
+const uint32_t VERSION = 1;
+
+
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t size;
+};
+
+
+struct State
+{
+  struct Framework
+  {
+    std::string role;
+    uint64_t allocations; // Times chosen by the framework sorter.
+  };
+
+  struct Slave
+  {
+    std::string hostname;
+    Resources total;
+  };
+
+  State() : time(0) {}
+
+  // Nanoseconds of the libprocess clock when the checkpoint was taken.
+  int64_t time;
+
+  hashmap<std::string, uint64_t> roles; // Times chosen by the role sorter.
+  hashmap<FrameworkID, Framework> frameworks;
+  hashmap<SlaveID, Slave> slaves;
+};
+
+
+// Atomically replaces the checkpoint at 'path'.
+Try<Nothing> write(const std::string& path, const State& state);
+
+
+// Like 'write', but on a thread of its own, so that the caller is not
+// held up by syncing the checkpoint to disk.
+process::Future<Nothing> save(const std::string& path, const State& state);
+
+
+// Returns the checkpoint at 'path', none if there is none, or an
+// error if it is corrupted or of an unsupported version.
+Result<State> read(const std::string& path);
+
+} // namespace checkpoint {
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_CHECKPOINT_HPP__
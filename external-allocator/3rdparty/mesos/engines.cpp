@@ -0,0 +1,65 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mesos/engines.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace engines {
+
+Try<Nothing> validate(const Flags& flags)
+{
+  if (flags.filter_index != "linear" && flags.filter_index != "slave") {
+    return Error("Unknown filter index '" + flags.filter_index + "'");
+  }
+
+  if (flags.event_log != "sync" &&
+      flags.event_log != "async" &&
+      flags.event_log != "off") {
+    return Error("Unknown event log mode '" + flags.event_log + "'");
+  }
+
+  if (flags.placement != "random" &&
+      flags.placement != "best_fit" &&
+      flags.placement != "dominant_fit") {
+    return Error("Unknown placement '" + flags.placement + "'");
+  }
+
+  if (flags.allocation_shards < 1) {
+    return Error("Number of allocation shards must be positive");
+  }
+
+  if (flags.event_log_sampling < 1) {
+    return Error("Event log sampling must be positive");
+  }
+
+  // Written this way round to reject NaN as well.
+  if (!(flags.recovery_quorum >= 0 && flags.recovery_quorum <= 1)) {
+    return Error("Recovery quorum must be between 0 and 1");
+  }
+
+  return Nothing();
+}
+
+} // namespace engines {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,137 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_ENGINES_HPP__
+#define __MASTER_ALLOCATOR_MESOS_ENGINES_HPP__
+
+#include <string>
+
+#include <mesos/master/allocator.hpp>
+
+#include <stout/error.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/nothing.hpp>
+#include <stout/stringify.hpp>
+#include <stout/try.hpp>
+
+#include "mesos/allocator.hpp"
+#include "mesos/flags.hpp"
+#include "mesos/hierarchical.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// An engine is a specialization of the hierarchical allocator for a
+// role sorter and a framework sorter. Engines are named after the
+// '--role_sorter' and '--framework_sorter' flags, e.g. "tree/drf",
+// and created through a 'Creator', which provides
+//
+//   typedef ... Type;
+//
+//   template <typename RoleSorter, typename FrameworkSorter>
+//   static Try<Type> create(const Flags& flags);
+//
+// so that the module and the offline tools pick the same engines.
+namespace engines {
+
+// Creates the allocator loaded by the master.
+template <template <typename, typename> class Process>
+struct AllocatorCreator
+{
+  typedef mesos::master::allocator::Allocator* Type;
+
+  template <typename RoleSorter, typename FrameworkSorter>
+  static Try<Type> create(const Flags& flags)
+  {
+    return MesosAllocator<Process<RoleSorter, FrameworkSorter> >::create(
+        flags);
+  }
+};
+
+
+// Creates a bare allocator process, as driven by the tools. 'Base'
+// is the type the tools need to dispatch to.
+template <
+    template <typename, typename> class Process,
+    typename Base = MesosAllocatorProcess>
+struct ProcessCreator
+{
+  typedef Base* Type;
+
+  template <typename RoleSorter, typename FrameworkSorter>
+  static Try<Type> create(const Flags& flags)
+  {
+    return new Process<RoleSorter, FrameworkSorter>(flags);
+  }
+};
+
+
+// Returns the name of the engine selected by the flags.
+inline std::string name(const Flags& flags)
+{
+  return flags.role_sorter + "/" + flags.framework_sorter;
+}
+
+
+// The compiled-in engines, keyed by name.
+template <typename Creator>
+hashmap<std::string, Try<typename Creator::Type> (*)(const Flags&)> all()
+{
+  hashmap<std::string, Try<typename Creator::Type> (*)(const Flags&)> all;
+  all["drf/drf"] = &Creator::template create<DRFSorter, DRFSorter>;
+  all["tree/drf"] = &Creator::template create<TreeSorter, DRFSorter>;
+  return all;
+}
+
+
+// Checks the flags whose values are not restricted by their type.
+Try<Nothing> validate(const Flags& flags);
+
+
+// Validates the flags and creates the engine they select.
+template <typename Creator>
+Try<typename Creator::Type> create(const Flags& flags)
+{
+  Try<Nothing> validation = validate(flags);
+  if (validation.isError()) {
+    return Error(validation.error());
+  }
+
+  const std::string engine = name(flags);
+
+  hashmap<std::string, Try<typename Creator::Type> (*)(const Flags&)>
+    factories = all<Creator>();
+
+  if (!factories.contains(engine)) {
+    return Error("Unknown allocator engine '" + engine + "', supported: " +
+                 stringify(factories.keys()));
+  }
+
+  return factories[engine](flags);
+}
+
+} // namespace engines {
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_ENGINES_HPP__
@@ -0,0 +1,282 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <string.h>
+
+#include <algorithm>
+#include <chrono>
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/option.hpp>
+
+#include "mesos/event_log.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Must be a power of two.
+static const uint64_t CAPACITY = 16384;
+
+// How long the background thread sleeps when there is nothing to log.
+static const std::chrono::milliseconds IDLE(10);
+
+
+EventLog::EventLog(Mode _mode, int _sampling)
+  : mode(_mode),
+    sampling(_sampling > 0 ? _sampling : 1),
+    events(0),
+    head(0),
+    tail(0),
+    dropped_(0),
+    running(true),
+    thread(NULL)
+{
+  if (mode == ASYNC) {
+    records.resize(CAPACITY);
+    thread = new std::thread(&EventLog::run, this);
+  }
+}
+
+
+EventLog::~EventLog()
+{
+  if (thread != NULL) {
+    running.store(false);
+    thread->join();
+    delete thread;
+  }
+}
+
+
+void EventLog::addSlave(
+    const SlaveID& slaveId,
+    const string& hostname,
+    const Resources& total,
+    const Resources& available)
+{
+  if (!sample()) {
+    return;
+  }
+
+  if (mode == SYNC) {
+    LOG(INFO) << "Added slave " << slaveId << " (" << hostname
+              << ") with " << total
+              << " (and " << available << " available)";
+    return;
+  }
+
+  Record record;
+  record.type = Record::ADD_SLAVE;
+  record.time = process::Clock::now();
+  record.frameworkId[0] = '\0';
+  copy(record.slaveId, sizeof(record.slaveId), slaveId.value());
+  record.first = scalars(total);
+  record.second = scalars(available);
+
+  push(record);
+}
+
+
+void EventLog::recoverResources(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& recovered,
+    const Resources& available,
+    const RangeResources& availableRanges)
+{
+  if (!sample()) {
+    return;
+  }
+
+  if (mode == SYNC) {
+    LOG(INFO) << "Recovered " << recovered
+              << " (total allocatable: "
+              << available + availableRanges.resources()
+              << ") on slave " << slaveId
+              << " from framework " << frameworkId;
+    return;
+  }
+
+  Record record;
+  record.type = Record::RECOVER_RESOURCES;
+  record.time = process::Clock::now();
+  copy(record.frameworkId, sizeof(record.frameworkId), frameworkId.value());
+  copy(record.slaveId, sizeof(record.slaveId), slaveId.value());
+  record.first = scalars(recovered);
+  record.second = scalars(available);
+
+  push(record);
+}
+
+
+void EventLog::updateAllocation(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& from,
+    const Resources& to)
+{
+  if (!sample()) {
+    return;
+  }
+
+  if (mode == SYNC) {
+    LOG(INFO) << "Updated allocation of framework " << frameworkId
+              << " on slave " << slaveId
+              << " from " << from << " to " << to;
+    return;
+  }
+
+  Record record;
+  record.type = Record::UPDATE_ALLOCATION;
+  record.time = process::Clock::now();
+  copy(record.frameworkId, sizeof(record.frameworkId), frameworkId.value());
+  copy(record.slaveId, sizeof(record.slaveId), slaveId.value());
+  record.first = scalars(from);
+  record.second = scalars(to);
+
+  push(record);
+}
+
+
+bool EventLog::sample()
+{
+  if (mode == OFF) {
+    return false;
+  }
+
+  return events++ % sampling == 0;
+}
+
+
+void EventLog::push(const Record& record)
+{
+  const uint64_t tail_ = tail.load(std::memory_order_relaxed);
+
+  if (tail_ - head.load(std::memory_order_acquire) == CAPACITY) {
+    dropped_.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+
+  records[tail_ & (CAPACITY - 1)] = record;
+  tail.store(tail_ + 1, std::memory_order_release);
+}
+
+
+void EventLog::run()
+{
+  while (true) {
+    const uint64_t head_ = head.load(std::memory_order_relaxed);
+    const uint64_t tail_ = tail.load(std::memory_order_acquire);
+
+    if (head_ == tail_) {
+      // Only stop once everything pushed so far is logged.
+      if (!running.load()) {
+        break;
+      }
+
+      std::this_thread::sleep_for(IDLE);
+      continue;
+    }
+
+    for (uint64_t i = head_; i != tail_; i++) {
+      format(records[i & (CAPACITY - 1)]);
+    }
+
+    head.store(tail_, std::memory_order_release);
+
+    const uint64_t count = dropped_.exchange(0);
+    if (count > 0) {
+      LOG(WARNING) << "Dropped " << count << " allocator events";
+    }
+  }
+}
+
+
+void EventLog::format(const Record& record)
+{
+  switch (record.type) {
+    case Record::ADD_SLAVE:
+      LOG(INFO) << "[" << record.time << "] Added slave " << record.slaveId
+                << " with cpus:" << record.first.cpus
+                << "; mem:" << record.first.mem
+                << "; disk:" << record.first.disk
+                << " (and cpus:" << record.second.cpus
+                << "; mem:" << record.second.mem
+                << "; disk:" << record.second.disk << " available)";
+      break;
+
+    case Record::RECOVER_RESOURCES:
+      LOG(INFO) << "[" << record.time << "] Recovered"
+                << " cpus:" << record.first.cpus
+                << "; mem:" << record.first.mem
+                << "; disk:" << record.first.disk
+                << " (total allocatable: cpus:" << record.second.cpus
+                << "; mem:" << record.second.mem
+                << "; disk:" << record.second.disk
+                << ") on slave " << record.slaveId
+                << " from framework " << record.frameworkId;
+      break;
+
+    case Record::UPDATE_ALLOCATION:
+      LOG(INFO) << "[" << record.time << "] Updated allocation of framework "
+                << record.frameworkId << " on slave " << record.slaveId
+                << " from cpus:" << record.first.cpus
+                << "; mem:" << record.first.mem
+                << "; disk:" << record.first.disk
+                << " to cpus:" << record.second.cpus
+                << "; mem:" << record.second.mem
+                << "; disk:" << record.second.disk;
+      break;
+  }
+}
+
+
+EventLog::Scalars EventLog::scalars(const Resources& resources)
+{
+  Option<double> cpus = resources.cpus();
+  Option<Bytes> mem = resources.mem();
+  Option<Bytes> disk = resources.disk();
+
+  Scalars scalars;
+  scalars.cpus = cpus.isSome() ? cpus.get() : 0;
+  scalars.mem = mem.isSome() ? mem.get().megabytes() : 0;
+  scalars.disk = disk.isSome() ? disk.get().megabytes() : 0;
+
+  return scalars;
+}
+
+
+void EventLog::copy(char* destination, size_t size, const string& id)
+{
+  size_t length = std::min(id.size(), size - 1);
+  memcpy(destination, id.data(), length);
+  destination[length] = '\0';
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,163 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_EVENT_LOG_HPP__
+#define __MASTER_ALLOCATOR_MESOS_EVENT_LOG_HPP__
+
+#include <stdint.h>
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+#include <process/time.hpp>
+
+#include "mesos/range_resources.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Logs the frequent allocator events, i.e. added slaves, recovered
+// resources and updated allocations.
+//
+// In 'async' mode the caller only copies a compact, fixed size record
+// into a lock-free single producer, single consumer ring buffer; a
+// background thread formats the records and writes them to the log.
+// Records only keep the cpus, mem and disk of the involved resources.
+// If the ring buffer is full, records are dropped rather than
+// blocking the caller.
+//
+// In 'sync' mode the full resources are formatted and logged on the
+// caller's thread, and 'off' disables the log. In both logging modes
+// only every 'sampling'-th event is logged.
+//
+// All methods except the destructor must be called from the same
+// thread, i.e. the allocator's.
+class EventLog
+{
+public:
+  enum Mode
+  {
+    OFF,
+    SYNC,
+    ASYNC
+  };
+
+  EventLog(Mode mode, int sampling);
+
+  ~EventLog();
+
+  void addSlave(
+      const SlaveID& slaveId,
+      const std::string& hostname,
+      const Resources& total,
+      const Resources& available);
+
+  // The available ranges are passed apart from the other available
+  // resources, as kept by the allocator, and only formatted in 'sync'
+  // mode.
+  void recoverResources(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& recovered,
+      const Resources& available,
+      const RangeResources& availableRanges);
+
+  void updateAllocation(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& from,
+      const Resources& to);
+
+  // Number of records dropped because the ring buffer was full.
+  uint64_t dropped() const { return dropped_.load(); }
+
+private:
+  struct Scalars
+  {
+    double cpus;
+    double mem;
+    double disk;
+  };
+
+  struct Record
+  {
+    enum Type
+    {
+      ADD_SLAVE,
+      RECOVER_RESOURCES,
+      UPDATE_ALLOCATION
+    };
+
+    Type type;
+    process::Time time;
+
+    // Identifiers are truncated to fit, which is enough to tell them
+    // apart in the log.
+    char frameworkId[64];
+    char slaveId[64];
+
+    // Meaning depends on the type: total and available resources of
+    // an added slave, recovered and available resources on the slave,
+    // old and new allocation.
+    Scalars first;
+    Scalars second;
+  };
+
+  EventLog(const EventLog&); // Not copyable.
+  EventLog& operator=(const EventLog&); // Not assignable.
+
+  // Returns true if the current event should be logged.
+  bool sample();
+
+  // Appends the record to the ring buffer, run on the caller's thread.
+  void push(const Record& record);
+
+  // Formats the buffered records, run on the background thread.
+  void run();
+
+  static void format(const Record& record);
+  static Scalars scalars(const Resources& resources);
+  static void copy(char* destination, size_t size, const std::string& id);
+
+  const Mode mode;
+  const int sampling;
+  uint64_t events;
+
+  // Ring buffer of 'CAPACITY' records. 'head' is only written by the
+  // consumer, 'tail' only by the producer.
+  std::vector<Record> records;
+  std::atomic<uint64_t> head;
+  std::atomic<uint64_t> tail;
+  std::atomic<uint64_t> dropped_;
+
+  std::atomic<bool> running;
+  std::thread* thread;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_EVENT_LOG_HPP__
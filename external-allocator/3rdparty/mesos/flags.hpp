@@ -0,0 +1,179 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_FLAGS_HPP__
+#define __MASTER_ALLOCATOR_MESOS_FLAGS_HPP__
+
+#include <stdint.h>
+
+#include <string>
+
+#include <stout/duration.hpp>
+#include <stout/flags.hpp>
+#include <stout/option.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Tuning knobs of the allocator. They are loaded from the module
+// parameters, e.g. in 'external-allocator.json':
+//
+//   "parameters": [ { "key": "filter_index", "value": "slave" } ]
+class Flags : public virtual flags::FlagsBase
+{
+public:
+  Flags()
+  {
+    add(&Flags::role_sorter,
+        "role_sorter",
+        "Sorter used to order roles. Supported values: 'drf', and\n"
+        "'tree', which sorts '/' separated nested roles, e.g.\n"
+        "'org/team/service', level by level.",
+        "drf");
+
+    add(&Flags::framework_sorter,
+        "framework_sorter",
+        "Sorter used to order frameworks within a role.\n"
+        "Supported values: 'drf'.",
+        "drf");
+
+    add(&Flags::trace,
+        "trace",
+        "If set, every allocator call is recorded to this file,\n"
+        "see 'mesos-allocator-replay'.");
+
+    add(&Flags::allocation_shards,
+        "allocation_shards",
+        "Number of shards slaves are split into. Every batch allocation\n"
+        "only considers the slaves of one shard, round-robin, trading\n"
+        "offer latency for shorter allocation cycles.",
+        1);
+
+    add(&Flags::allocation_coalescing_window,
+        "allocation_coalescing_window",
+        "Allocations triggered by events, e.g. a slave being added or a\n"
+        "framework reviving offers, are delayed by up to this long and\n"
+        "coalesced into one allocation. Zero allocates immediately.",
+        Duration::zero());
+
+    add(&Flags::allocation_cycle_budget,
+        "allocation_cycle_budget",
+        "If set, an allocation stops once it has taken longer than this\n"
+        "and leaves the remaining slaves for the next allocation.");
+
+    add(&Flags::filter_index,
+        "filter_index",
+        "How refuse filters are looked up. 'linear' scans all filters of\n"
+        "a framework, 'slave' indexes them by slave.",
+        "linear");
+
+    add(&Flags::event_log,
+        "event_log",
+        "How added slaves, recovered resources and updated allocations\n"
+        "are logged. 'sync' formats them on the allocator's thread,\n"
+        "'async' only copies a compact record and leaves formatting to a\n"
+        "background thread, 'off' disables logging them.",
+        "async");
+
+    add(&Flags::event_log_sampling,
+        "event_log_sampling",
+        "Only every n-th of the events above is logged.",
+        1);
+
+    add(&Flags::checkpoint,
+        "checkpoint",
+        "If set, the allocator periodically checkpoints the state that\n"
+        "re-registrations do not restore, e.g. how often every role and\n"
+        "framework has been allocated to, to this file and loads it\n"
+        "after a master failover.");
+
+    add(&Flags::checkpoint_interval,
+        "checkpoint_interval",
+        "How often the allocator state is checkpointed, see '--checkpoint'.",
+        Seconds(10));
+
+    add(&Flags::recovery_quorum,
+        "recovery_quorum",
+        "Fraction of the slaves of a recovered checkpoint, see\n"
+        "'--checkpoint', that must re-register before the allocator makes\n"
+        "offers again. Until then re-registrations are accepted in bulk:\n"
+        "no allocations are made and the sorters only learn about the\n"
+        "resources in use once the quorum is reached. Zero disables the\n"
+        "bulk recovery.",
+        0.8);
+
+    add(&Flags::recovery_timeout,
+        "recovery_timeout",
+        "How long the allocator waits for '--recovery_quorum' at most.",
+        Minutes(10));
+
+    add(&Flags::max_offers_per_framework,
+        "max_offers_per_framework",
+        "Maximum number of outstanding offers per framework, e.g. 50 as\n"
+        "'MAX_OFFERS_PER_FRAMEWORK' in the master. An offer is outstanding\n"
+        "until resources of the framework on its slave are recovered,\n"
+        "i.e. until it is declined or rescinded, or until the tasks\n"
+        "launched from it finish. Frameworks at the cap are skipped.\n"
+        "Zero means no cap.",
+        0);
+
+    add(&Flags::placement,
+        "placement",
+        "How slaves are chosen for frameworks that requested resources,\n"
+        "see 'requestResources'. 'random' offers shuffled slaves to all\n"
+        "frameworks alike. 'best_fit' first offers every such framework\n"
+        "the slave with the least capacity left that fits the requested\n"
+        "task shape, summing up cpus, mem and disk relative to the largest\n"
+        "slave, 'dominant_fit' the slave whose largest such share is the\n"
+        "smallest that fits. Either way, the frameworks then take part in\n"
+        "the regular allocation.",
+        "random");
+
+    add(&Flags::random_seed,
+        "random_seed",
+        "Seed of the random order slaves are allocated from. Random if\n"
+        "not set. Traces record the seed, see '--trace', which replays\n"
+        "use unless given another one.");
+  }
+
+  std::string role_sorter;
+  std::string framework_sorter;
+  Option<std::string> trace;
+  int allocation_shards;
+  Duration allocation_coalescing_window;
+  Option<Duration> allocation_cycle_budget;
+  std::string filter_index;
+  std::string event_log;
+  int event_log_sampling;
+  Option<std::string> checkpoint;
+  Duration checkpoint_interval;
+  double recovery_quorum;
+  Duration recovery_timeout;
+  int max_offers_per_framework;
+  std::string placement;
+  Option<uint32_t> random_seed;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_FLAGS_HPP__
@@ -19,24 +19,56 @@
 #ifndef __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 #define __MASTER_ALLOCATOR_MESOS_HIERARCHICAL_HPP__
 
+#include <stdint.h>
+
 #include <algorithm>
+#include <cmath>
+#include <list>
+#include <map>
+#include <memory>
+#include <random>
+#include <set>
+#include <string>
+#include <utility>
 #include <vector>
 
+#include <mesos/attributes.hpp>
 #include <mesos/resources.hpp>
 #include <mesos/type_utils.hpp>
 
+#include <process/clock.hpp>
+#include <process/defer.hpp>
 #include <process/delay.hpp>
+#include <process/future.hpp>
+#include <process/http.hpp>
 #include <process/id.hpp>
 #include <process/timeout.hpp>
 
+#include <process/metrics/gauge.hpp>
+#include <process/metrics/metrics.hpp>
+
 #include <stout/check.hpp>
 #include <stout/duration.hpp>
 #include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
+#include <stout/nothing.hpp>
 #include <stout/stopwatch.hpp>
 #include <stout/stringify.hpp>
+#include <stout/unreachable.hpp>
 
 #include "mesos/allocator.hpp"
+#include "mesos/checkpoint.hpp"
+#include "mesos/event_log.hpp"
+#include "mesos/flags.hpp"
+#include "mesos/metrics.hpp"
+#include "mesos/range_resources.hpp"
+#include "mesos/resources_pool.hpp"
+#include "mesos/scalar_vector.hpp"
+#include "mesos/snapshot.hpp"
+#include "mesos/state.hpp"
 #include "sorter/drf/sorter.hpp"
+#include "sorter/tree/sorter.hpp"
 
 namespace mesos {
 namespace internal {
@@ -48,7 +80,7 @@ class Filter;
 
 
 // We forward declare the hierarchical allocator process so that we
-// can typedef an instantiation of it with DRF sorters.
+// can typedef instantiations of it with the available sorters.
 template <typename RoleSorter, typename FrameworkSorter>
 class HierarchicalAllocatorProcess;
 
@@ -58,6 +90,13 @@ HierarchicalDRFAllocatorProcess;
 typedef MesosAllocator<HierarchicalDRFAllocatorProcess>
 HierarchicalDRFAllocator;
 
+// Sorts nested roles, e.g. "org/team/service", as a tree.
+typedef HierarchicalAllocatorProcess<TreeSorter, DRFSorter>
+HierarchicalTreeAllocatorProcess;
+
+typedef MesosAllocator<HierarchicalTreeAllocatorProcess>
+HierarchicalTreeAllocator;
+
 
 // Implements the basic allocator algorithm - first pick a role by
 // some criteria, then pick one of their frameworks to allocate to.
@@ -65,7 +104,7 @@ template <typename RoleSorter, typename FrameworkSorter>
 class HierarchicalAllocatorProcess : public MesosAllocatorProcess
 {
 public:
-  HierarchicalAllocatorProcess();
+  explicit HierarchicalAllocatorProcess(const Flags& flags = Flags());
 
   virtual ~HierarchicalAllocatorProcess();
 
@@ -128,6 +167,52 @@ public:
   void reviveOffers(
       const FrameworkID& frameworkId);
 
+  void bulkRecoverResources(
+      const std::vector<RecoveredResources>& recovered);
+
+  void suppressOffers(
+      const FrameworkID& frameworkId);
+
+  void addRole(
+      const std::string& role,
+      const mesos::master::RoleInfo& roleInfo);
+
+  void removeRole(
+      const std::string& role);
+
+  void updateWeights(
+      const std::vector<mesos::master::RoleInfo>& roleInfos);
+
+  void setQuota(
+      const std::string& role,
+      const Resources& guarantee);
+
+  void removeQuota(
+      const std::string& role);
+
+  void updateSlave(
+      const SlaveID& slaveId,
+      const Resources& oversubscribed);
+
+  void updateConstraints(
+      const FrameworkID& frameworkId,
+      const std::string& constraints);
+
+  Option<Error> checkUpdateAllocation(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const std::vector<Offer::Operation>& operations);
+
+  Option<Error> checkRecoverResources(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources);
+
+  // Returns the snapshot published after the latest batch allocation.
+  // NOTE: Unlike the methods above, this can be called directly from
+  // any thread, rather than dispatched.
+  std::shared_ptr<const Snapshot> snapshot() const;
+
 protected:
   // Useful typedefs for dispatch/delay/defer to self()/this.
   typedef HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter> Self;
@@ -136,17 +221,49 @@ protected:
   // Callback for doing batch allocations.
   void batch();
 
-  // Allocate any allocatable resources.
+  // Allocate any allocatable resources. Unless allocations are
+  // coalesced, see '_allocate'.
   void allocate();
 
-  // Allocate resources just from the specified slave.
+  // Allocate resources just from the specified slave. Unless
+  // allocations are coalesced, see '_allocate'.
   void allocate(const SlaveID& slaveId);
 
   // Allocate resources from the specified slaves.
   void allocate(const hashset<SlaveID>& slaveIds);
 
+  // Allocate resources from the slaves accumulated in
+  // 'allocationCandidates' during the coalescing window.
+  void _allocate();
+
   // Remove a filter for the specified framework.
-  void expire(const FrameworkID& frameworkId, Filter* filter);
+  void expire(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      Filter* filter);
+
+  // A filter along with the framework and slave it was installed for.
+  struct ExpiringFilter
+  {
+    FrameworkID frameworkId;
+    SlaveID slaveId;
+    Filter* filter;
+  };
+
+  // Remove filters installed at once with the same timeout, so that
+  // they share a timer.
+  void expireFilters(const std::vector<ExpiringFilter>& filters);
+
+  // Returns for how long the filters refuse resources, falling back
+  // to the default if they specify an invalid duration.
+  Duration refuseDuration(const Filters& filters);
+
+  // Installs a refused resources filter, which is yet to be expired.
+  Filter* installFilter(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      const Duration& duration);
 
   // Checks whether the slave is whitelisted.
   bool isWhitelisted(const SlaveID& slaveId);
@@ -156,10 +273,155 @@ protected:
   bool isFiltered(
       const FrameworkID& frameworkId,
       const SlaveID& slaveId,
-      const Resources& resources);
+      const SharedResources& resources);
 
   bool allocatable(const Resources& resources);
 
+  // Accounts for an outstanding offer of the framework on the slave
+  // being resolved, see '--max_offers_per_framework'.
+  void resolveOffer(const FrameworkID& frameworkId, const SlaveID& slaveId);
+
+  // Keeps the framework in its role's sorter only while it is active
+  // and has not suppressed offers, and its role in the role sorter
+  // only while it has such frameworks, see 'activeRoles'.
+  void updateSorted(const FrameworkID& frameworkId);
+
+  // Accounts for resources allocated to or unallocated from the
+  // frameworks of a role, in the role sorter and against the role's
+  // quota.
+  void roleAllocated(const std::string& role, const Resources& resources);
+  void roleUnallocated(const std::string& role, const Resources& resources);
+  void roleUpdated(
+      const std::string& role,
+      const Resources& oldAllocation,
+      const Resources& newAllocation);
+
+  // Updates whether the role's allocation covers its quota.
+  void updateQuota(const std::string& role);
+
+  // Offers resources of the slave to the framework, taking them out
+  // of the resources available on the slave and accounting for them
+  // in the sorters.
+  void grant(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      hashmap<FrameworkID, hashmap<SlaveID, Resources> >* offerable,
+      CycleStats* stats);
+
+  // Returns the capacity the scalars make up relative to the largest
+  // slave, as ordered by '--placement'.
+  double fitKey(const ScalarVector& scalars) const;
+
+  // Brings the slave's key in 'fitKeys' up to date, or removes it if
+  // the slave is gone.
+  void updateFitKey(const SlaveID& slaveId);
+
+  // Returns the roles in the order they are offered a slave: the
+  // roles short of their quota, unless stalled, see 'stalledQuota',
+  // then all others, each in sort order. The roles put first are
+  // added to 'prioritized', if given.
+  std::list<std::string> sortRoles(hashset<std::string>* prioritized);
+
+  // Returns the key of the attribute in 'attributeIndex', i.e., its
+  // name and value as in "rack:r1".
+  static std::string attributeKey(const Attribute& attribute);
+
+  // Returns which of the slaves have all of the attributes, starting
+  // from the attribute with the fewest slaves in 'attributeIndex'.
+  hashset<SlaveID> matching(
+      const std::vector<std::string>& attributes,
+      const hashset<SlaveID>& slaveIds);
+
+  // Checks whether the framework's constraints exclude the slave
+  // from the current allocation, see 'constrainedSlaves'.
+  bool isConstrained(const FrameworkID& frameworkId, const SlaveID& slaveId);
+
+  // Accounts for the framework being passed over for a slave, along
+  // with its role.
+  void skipped(
+      const FrameworkID& frameworkId,
+      SkipReason reason,
+      const process::Time& now);
+
+  // Exports the 'ClientStats' of the framework or role, as of the
+  // published snapshot, as gauges, named
+  // "allocator/frameworks/<id>/<metric>" and
+  // "allocator/roles/<role>/<metric>" respectively.
+  void addFrameworkGauges(const FrameworkID& frameworkId);
+  void addRoleGauges(const std::string& role);
+  void removeGauges(const std::string& prefix);
+
+  // Gauge values, read from the published snapshot rather than
+  // dispatched to the allocator, which keeps scraping the metrics off
+  // the allocation queue.
+  static process::Future<double> frameworkMetric(
+      const std::shared_ptr<const Publication>& publication,
+      const FrameworkID& frameworkId,
+      ClientMetric metric);
+
+  static process::Future<double> roleMetric(
+      const std::shared_ptr<const Publication>& publication,
+      const std::string& role,
+      ClientMetric metric);
+
+  // Publishes a new snapshot, once per batch allocation. Only the
+  // slaves in 'changedSlaves' are rebuilt, as are the roles and
+  // frameworks which changed, see 'Snapshot'.
+  void publish();
+
+  // Restores the allocation counters of the roles from a checkpoint
+  // and keeps the frameworks and slaves of the checkpoint around to
+  // reconcile them as they re-register, see '--checkpoint'.
+  void recover(const checkpoint::State& state);
+
+  // Checkpoints the allocator state, see '--checkpoint'. The state is
+  // taken here, but written by 'checkpoint::save' in the background.
+  void writeCheckpoint();
+
+  // Reports the checkpoint written by 'writeCheckpoint' and schedules
+  // the next one, so that checkpoints are never written concurrently.
+  void checkpointed(
+      const process::Future<Nothing>& write,
+      const Stopwatch& stopwatch,
+      size_t frameworks,
+      size_t slaves);
+
+  // Ends the bulk recovery, see '--recovery_quorum': adds the
+  // allocations re-registered in the meantime to the sorters and
+  // allocates from all slaves.
+  void endRecovery();
+
+  // Adds the allocation of the framework re-registered during the
+  // bulk recovery to the sorters.
+  void allocatePending(const FrameworkID& frameworkId);
+
+  // Returns the allocation of the framework, including the one still
+  // pending, see 'allocatePending'.
+  Resources allocationOf(const FrameworkID& frameworkId);
+
+  // HTTP endpoint reporting the latency of each allocation phase.
+  process::Future<process::http::Response> cycles(
+      const process::http::Request& request);
+
+  // HTTP endpoint streaming the latest snapshot as JSON.
+  process::Future<process::http::Response> state(
+      const process::http::Request& request);
+
+  const Flags flags;
+
+  // Orders slaves and slave classes within an allocation, seeded by
+  // '--random_seed'.
+  std::mt19937 random;
+
+  EventLog eventLog;
+
+  Metrics metrics;
+
+  // Resources of slaves and filters, shared between identical ones.
+  // Declared before them since it must outlive them.
+  ResourcesPool resourcesPool;
+
   bool initialized;
 
   Duration allocationInterval;
@@ -168,31 +430,110 @@ protected:
       void(const FrameworkID&,
            const hashmap<SlaveID, Resources>&)> offerCallback;
 
+  // Boolean capabilities of slaves that frameworks might require, as
+  // bits of a mask. A framework is only offered the slaves having all
+  // of the capabilities it requires, which is checked before any
+  // resources are looked at.
+  enum Capability
+  {
+    CHECKPOINTING = 1 << 0
+  };
+
   struct Framework
   {
     std::string role;
     bool checkpoint;  // Whether the framework desires checkpointing.
 
+    // Bits of 'Capability' a slave must have to be offered to the
+    // framework.
+    uint32_t requiredCapabilities;
+
+    bool active; // Whether the framework is activated.
+
+    // Whether the framework suppressed offers, which keeps it out of
+    // its role's sorter until it revives offers.
+    bool suppressed;
+
+    // Whether the framework is active in its role's sorter.
+    bool sorted;
+
+    // Whether the framework accepts revocable resources.
+    bool revocable;
+
+    // The shape of the framework's tasks, from its latest resource
+    // request, which '--placement' fits slaves to.
+    Option<ScalarVector> taskShape;
+
+    // How the framework is served, exported as gauges.
+    ClientStats stats;
+
+    // Keys of the attributes a slave must have to be offered to the
+    // framework, see 'updateConstraints', sorted, along with their
+    // concatenation, which is shared by frameworks with the same
+    // constraints.
+    std::vector<std::string> constraints;
+    std::string constraintsId;
+
     hashset<Filter*> filters; // Active filters for the framework.
+
+    // Active filters indexed by slave, only maintained with
+    // '--filter_index=slave'.
+    hashmap<SlaveID, hashset<Filter*> > slaveFilters;
+
+    // Outstanding offers per slave and in total, only maintained with
+    // '--max_offers_per_framework'.
+    hashmap<SlaveID, size_t> offers;
+    size_t offerCount;
   };
 
   hashmap<FrameworkID, Framework> frameworks;
 
   struct Slave
   {
-    Resources total;
-    Resources available;
+    SharedResources total;
+
+    // The available resources are split into the ranges, e.g. ports,
+    // which might be heavily fragmented, and all other resources.
+    SharedResources available;
+    RangeResources availableRanges;
+
+    // Revocable resources are kept apart from the resources above and
+    // out of the sorters: 'revocable' is the latest estimate, see
+    // 'updateSlave', of which 'allocatedRevocable' is allocated.
+    Resources revocable;
+    Resources allocatedRevocable;
+
+    Attributes attributes;
 
     bool activated;  // Whether to offer resources.
-    bool checkpoint; // Whether slave supports checkpointing.
+
+    uint32_t capabilities; // Bits of 'Capability'.
 
     std::string hostname;
   };
 
   hashmap<SlaveID, Slave> slaves;
 
+  // Slaves offering identical resources during an allocation. Since
+  // slaves with different capabilities never share a class, the
+  // classes also partition the slaves by capabilities.
+  struct EquivalenceClass
+  {
+    SharedResources available;
+    RangeResources availableRanges;
+    uint32_t capabilities;
+
+    std::vector<SlaveID> slaveIds;
+  };
+
   hashmap<std::string, mesos::master::RoleInfo> roles;
 
+  // How each role is served, exported as gauges.
+  hashmap<std::string, ClientStats> roleStats;
+
+  // The gauges of the frameworks and roles, by name prefix.
+  hashmap<std::string, std::vector<process::metrics::Gauge> > gauges;
+
   // Slaves to send offers for.
   Option<hashset<std::string> > whitelist;
 
@@ -204,8 +545,113 @@ protected:
   //   Both reserved resources and unreserved resources are used
   //   in the fairness calculation. This is because reserved
   //   resources can be allocated to any framework in the role.
+  // Framework sorters are only created for roles with frameworks.
   RoleSorter* roleSorter;
   hashmap<std::string, FrameworkSorter*> frameworkSorters;
+
+  // Number of frameworks active in the sorter of each role, for roles
+  // with any. Only these roles are active in the role sorter, hence
+  // allocations skip roles without active frameworks.
+  hashmap<std::string, size_t> activeRoles;
+
+  // The scalar quantities guaranteed to a role and those allocated to
+  // its frameworks, which are kept up to date along with the role
+  // sorter, so that checking whether the quota is met is cheap.
+  struct Quota
+  {
+    // Whether allocating the scalars gets the role closer to its
+    // guarantee.
+    bool helps(const ScalarVector& scalars) const
+    {
+      for (int i = 0; i < ScalarVector::DIMENSIONS; i++) {
+        const ScalarVector::Index index = static_cast<ScalarVector::Index>(i);
+
+        if (scalars.get(index) > 0 &&
+            allocated.get(index) < guaranteed.get(index)) {
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    ScalarVector guaranteed;
+    ScalarVector allocated;
+  };
+
+  hashmap<std::string, Quota> quotas;
+
+  // Roles whose allocation does not cover their quota yet, which are
+  // allocated to before any other role.
+  hashset<std::string> unmetQuota;
+
+  // Roles short of their quota that were offered a slave first during
+  // the current allocation without getting closer to their quota,
+  // e.g. since it is for resources the slaves lack. They lose their
+  // priority for the rest of the allocation, rather than holding up
+  // every slave.
+  hashset<std::string> stalledQuota;
+
+  // The capacity left on each slave, see '--placement' and 'fitKey'.
+  // Keys are brought up to date for the slaves in 'changedSlaves' once
+  // an allocation starts, and for those allocated from as it goes.
+  hashmap<SlaveID, double> fitKeys;
+
+  // Number of slaves looked at for a framework's task shape, past the
+  // least capacity the shape could fit into, before the framework is
+  // left to the regular allocation.
+  static const size_t FIT_SCAN_LIMIT = 32;
+
+  // The largest amount of cpus, mem and disk of any slave, which
+  // capacity is relative to.
+  double fitReference[ScalarVector::DIMENSIONS];
+
+  // Slaves by attribute, see 'attributeKey'.
+  hashmap<std::string, hashset<SlaveID> > attributeIndex;
+
+  // The slaves of the current allocation matching the constraints of
+  // the frameworks, by 'Framework::constraintsId'. Only computed once
+  // per distinct constraints and allocation.
+  hashmap<std::string, hashset<SlaveID> > constrainedSlaves;
+
+  // Shard considered by the next batch allocation, see
+  // '--allocation_shards'.
+  int shard;
+
+  // Slaves to allocate from once the coalescing window closes,
+  // unless all slaves are to be allocated from.
+  hashset<SlaveID> allocationCandidates;
+  bool allocateAll;
+
+  // Whether a coalesced allocation is scheduled.
+  bool allocationPending;
+
+  // Slaves and frameworks changed since the last published snapshot.
+  hashset<SlaveID> changedSlaves;
+  hashset<FrameworkID> changedFrameworks;
+
+  const std::shared_ptr<Publication> published;
+
+  // Frameworks and slaves of the recovered checkpoint that have not
+  // re-registered yet.
+  hashmap<FrameworkID, checkpoint::State::Framework> recoveredFrameworks;
+  hashmap<SlaveID, checkpoint::State::Slave> recoveredSlaves;
+
+  // Started once the checkpoint is recovered, to time how long it
+  // takes for its slaves to re-register.
+  Stopwatch recovery;
+
+  // Whether re-registrations are accepted in bulk, see
+  // '--recovery_quorum'. No allocations are made meanwhile.
+  bool recovering;
+
+  // Number of slaves of the checkpoint that end the bulk recovery
+  // once they all re-registered.
+  size_t recoveryQuorum;
+
+  // Allocations re-registered during the bulk recovery, which are
+  // only added to the sorters once it ends.
+  hashmap<FrameworkID, Resources> pendingAllocations;
 };
 
 
@@ -215,7 +661,9 @@ class Filter
 public:
   virtual ~Filter() {}
 
-  virtual bool filter(const SlaveID& slaveId, const Resources& resources) = 0;
+  virtual bool filter(
+      const SlaveID& slaveId,
+      const SharedResources& resources) = 0;
 };
 
 
@@ -224,11 +672,13 @@ class RefusedFilter: public Filter
 public:
   RefusedFilter(
       const SlaveID& _slaveId,
-      const Resources& _resources,
+      const SharedResources& _resources,
       const process::Timeout& _timeout)
     : slaveId(_slaveId), resources(_resources), timeout(_timeout) {}
 
-  virtual bool filter(const SlaveID& _slaveId, const Resources& _resources)
+  virtual bool filter(
+      const SlaveID& _slaveId,
+      const SharedResources& _resources)
   {
     return slaveId == _slaveId &&
            resources.contains(_resources) && // Refused resources are superset.
@@ -236,20 +686,43 @@ public:
   }
 
   const SlaveID slaveId;
-  const Resources resources;
+  const SharedResources resources;
   const process::Timeout timeout;
 };
 
 
 template <class RoleSorter, class FrameworkSorter>
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::HierarchicalAllocatorProcess() // NOLINT(whitespace/line_length)
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::HierarchicalAllocatorProcess( // NOLINT(whitespace/line_length)
+    const Flags& _flags)
   : ProcessBase(process::ID::generate("hierarchical-allocator")),
-    initialized(false) {}
+    flags(_flags),
+    random(flags.random_seed.isSome()
+             ? flags.random_seed.get()
+             : std::random_device()()),
+    eventLog(
+        flags.event_log == "sync"
+          ? EventLog::SYNC
+          : flags.event_log == "off" ? EventLog::OFF : EventLog::ASYNC,
+        flags.event_log_sampling),
+    initialized(false),
+    shard(0),
+    allocateAll(false),
+    allocationPending(false),
+    published(new Publication()),
+    recovering(false),
+    recoveryQuorum(0)
+{
+  std::fill(fitReference, fitReference + ScalarVector::DIMENSIONS, 0.0);
+}
 
 
 template <class RoleSorter, class FrameworkSorter>
 HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::~HierarchicalAllocatorProcess() // NOLINT(whitespace/line_length)
-{}
+{
+  foreach (const std::string& prefix, gauges.keys()) {
+    removeGauges(prefix);
+  }
+}
 
 
 template <class RoleSorter, class FrameworkSorter>
@@ -274,15 +747,36 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::initialize(
   roles = _roles;
   initialized = true;
 
+  // Roles are activated along with their first active framework.
   roleSorter = new RoleSorter();
   foreachpair (
       const std::string& name, const mesos::master::RoleInfo& roleInfo, roles) {
     roleSorter->add(name, roleInfo.weight());
-    frameworkSorters[name] = new FrameworkSorter();
+    roleSorter->deactivate(name);
+
+    roleStats[name] = ClientStats(process::Clock::now());
+    addRoleGauges(name);
   }
 
   if (roleSorter->count() == 0) {
-    LOG(ERROR) << "No roles specified, cannot allocate resources!";
+    LOG(WARNING) << "No roles specified, cannot allocate resources until "
+                 << "roles are added";
+  }
+
+  route("/cycles.json", None(), &Self::cycles);
+  route("/state.json", None(), &Self::state);
+
+  if (flags.checkpoint.isSome()) {
+    Result<checkpoint::State> state =
+      checkpoint::read(flags.checkpoint.get());
+
+    if (state.isError()) {
+      LOG(WARNING) << "Ignoring allocator checkpoint: " << state.error();
+    } else if (state.isSome()) {
+      recover(state.get());
+    }
+
+    delay(flags.checkpoint_interval, self(), &Self::writeCheckpoint);
   }
 
   VLOG(1) << "Initialized hierarchical allocator process";
@@ -302,11 +796,25 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addFramework(
 
   const std::string& role = frameworkInfo.role();
 
-  CHECK(roles.contains(role));
+  // Roles not known yet are added with the default weight.
+  if (!roles.contains(role)) {
+    mesos::master::RoleInfo roleInfo;
+    roleInfo.set_name(role);
+    addRole(role, roleInfo);
+  }
+
+  if (!frameworkSorters.contains(role)) {
+    frameworkSorters[role] = new FrameworkSorter();
+  }
 
   CHECK(!frameworkSorters[role]->contains(frameworkId.value()));
   frameworkSorters[role]->add(frameworkId.value());
 
+  // Frameworks are added to the sorter as active.
+  if (activeRoles[role]++ == 0) {
+    roleSorter->activate(role);
+  }
+
   // TODO(bmahler): Validate that the reserved resources have the
   // framework's role.
 
@@ -314,18 +822,60 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addFramework(
   // TODO(mpark): Once the sorter API is updated to operate on
   // 'hashmap<SlaveID, Resources>' rather than 'Resources', update
   // the sorters for each slave instead.
-  Resources used = Resources::sum(used_);
-  roleSorter->allocated(role, used.unreserved());
-  frameworkSorters[role]->add(used);
-  frameworkSorters[role]->allocated(frameworkId.value(), used);
+  // NOTE: Revocable resources are not accounted for in the sorters.
+  Resources used = Resources::sum(used_).nonRevocable();
+
+  if (recovering) {
+    pendingAllocations[frameworkId] += used;
+  } else {
+    roleAllocated(role, used);
+    frameworkSorters[role]->add(used);
+    frameworkSorters[role]->allocated(frameworkId.value(), used);
+  }
+
+  if (recoveredFrameworks.contains(frameworkId)) {
+    if (recoveredFrameworks[frameworkId].role == role) {
+      frameworkSorters[role]->setAllocationCount(
+          frameworkId.value(),
+          recoveredFrameworks[frameworkId].allocations);
+    }
+
+    recoveredFrameworks.erase(frameworkId);
+  }
 
   frameworks[frameworkId] = Framework();
   frameworks[frameworkId].role = frameworkInfo.role();
   frameworks[frameworkId].checkpoint = frameworkInfo.checkpoint();
 
+  // Do not offer a non-checkpointing slave's resources to a
+  // checkpointing framework. This is a short term fix until the
+  // following is resolved:
+  // https://issues.apache.org/jira/browse/MESOS-444.
+  frameworks[frameworkId].requiredCapabilities =
+    frameworkInfo.checkpoint() ? CHECKPOINTING : 0;
+  frameworks[frameworkId].active = true;
+  frameworks[frameworkId].sorted = true;
+  frameworks[frameworkId].revocable = false;
+  frameworks[frameworkId].stats = ClientStats(process::Clock::now());
+
+  foreach (const FrameworkInfo::Capability& capability,
+           frameworkInfo.capabilities()) {
+    if (capability.type() ==
+          FrameworkInfo::Capability::REVOCABLE_RESOURCES) {
+      frameworks[frameworkId].revocable = true;
+    }
+  }
+
+  changedFrameworks.insert(frameworkId);
+
+  addFrameworkGauges(frameworkId);
+
   LOG(INFO) << "Added framework " << frameworkId;
 
-  allocate();
+  // Allocations are deferred to 'endRecovery' during a bulk recovery.
+  if (!recovering) {
+    allocate();
+  }
 }
 
 
@@ -339,22 +889,39 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::removeFramework(
   CHECK(frameworks.contains(frameworkId));
   const std::string& role = frameworks[frameworkId].role;
 
+  // Not added to the sorters yet.
+  pendingAllocations.erase(frameworkId);
+
+  // Deactivates the role if this was its last active framework.
+  frameworks[frameworkId].active = false;
+  updateSorted(frameworkId);
+
   // Might not be in 'frameworkSorters[role]' because it was previously
   // deactivated and never re-added.
   if (frameworkSorters[role]->contains(frameworkId.value())) {
     Resources allocation =
       frameworkSorters[role]->allocation(frameworkId.value());
 
-    roleSorter->unallocated(role, allocation.unreserved());
+    roleUnallocated(role, allocation);
     frameworkSorters[role]->remove(allocation);
     frameworkSorters[role]->remove(frameworkId.value());
   }
 
+  // The framework sorter goes away along with the last framework of
+  // the role.
+  if (frameworkSorters[role]->count() == 0) {
+    delete frameworkSorters[role];
+    frameworkSorters.erase(role);
+  }
+
   // Do not delete the filters contained in this
   // framework's 'filters' hashset yet, see comments in
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
   frameworks.erase(frameworkId);
+  changedFrameworks.insert(frameworkId);
+
+  removeGauges("allocator/frameworks/" + frameworkId.value() + "/");
 
   LOG(INFO) << "Removed framework " << frameworkId;
 }
@@ -368,9 +935,11 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::activateFramework(
   CHECK(initialized);
 
   CHECK(frameworks.contains(frameworkId));
-  const std::string& role = frameworks[frameworkId].role;
 
-  frameworkSorters[role]->activate(frameworkId.value());
+  // A suppressed framework stays out of the sorter until it revives
+  // offers.
+  frameworks[frameworkId].active = true;
+  updateSorted(frameworkId);
 
   LOG(INFO) << "Activated framework " << frameworkId;
 
@@ -386,9 +955,9 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::deactivateFramework(
   CHECK(initialized);
 
   CHECK(frameworks.contains(frameworkId));
-  const std::string& role = frameworks[frameworkId].role;
 
-  frameworkSorters[role]->deactivate(frameworkId.value());
+  frameworks[frameworkId].active = false;
+  updateSorted(frameworkId);
 
   // Note that the Sorter *does not* remove the resources allocated
   // to this framework. For now, this is important because if the
@@ -401,6 +970,13 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::deactivateFramework(
   // HierarchicalAllocatorProcess::reviveOffers and
   // HierarchicalAllocatorProcess::expire.
   frameworks[frameworkId].filters.clear();
+  frameworks[frameworkId].slaveFilters.clear();
+
+  // The master rescinds the offers of a deactivated framework.
+  frameworks[frameworkId].offers.clear();
+  frameworks[frameworkId].offerCount = 0;
+
+  changedFrameworks.insert(frameworkId);
 
   LOG(INFO) << "Deactivated framework " << frameworkId;
 }
@@ -420,32 +996,100 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addSlave(
   roleSorter->add(total.unreserved());
 
   foreachpair (const FrameworkID& frameworkId,
-               const Resources& allocated,
+               const Resources& allocated_,
                used) {
-    if (frameworks.contains(frameworkId)) {
+    const Resources allocated = allocated_.nonRevocable();
+
+    if (recovering && frameworks.contains(frameworkId)) {
+      pendingAllocations[frameworkId] += allocated;
+    } else if (frameworks.contains(frameworkId)) {
       const std::string& role = frameworks[frameworkId].role;
 
       // TODO(bmahler): Validate that the reserved resources have the
       // framework's role.
 
-      roleSorter->allocated(role, allocated.unreserved());
+      roleAllocated(role, allocated);
       frameworkSorters[role]->add(allocated);
       frameworkSorters[role]->allocated(frameworkId.value(), allocated);
+
+      changedFrameworks.insert(frameworkId);
     }
   }
 
+  const Resources available = total - Resources::sum(used).nonRevocable();
+
   slaves[slaveId] = Slave();
-  slaves[slaveId].total = total;
-  slaves[slaveId].available = total - Resources::sum(used);
+  slaves[slaveId].total = resourcesPool.intern(total);
+  slaves[slaveId].available =
+    resourcesPool.intern(RangeResources::strip(available));
+  slaves[slaveId].availableRanges = RangeResources(available);
+  slaves[slaveId].allocatedRevocable = Resources::sum(used).revocable();
   slaves[slaveId].activated = true;
-  slaves[slaveId].checkpoint = slaveInfo.checkpoint();
+  slaves[slaveId].capabilities =
+    slaveInfo.checkpoint() ? CHECKPOINTING : 0;
   slaves[slaveId].hostname = slaveInfo.hostname();
+  slaves[slaveId].attributes = slaveInfo.attributes();
+
+  foreach (const Attribute& attribute, slaves[slaveId].attributes) {
+    attributeIndex[attributeKey(attribute)].insert(slaveId);
+  }
 
-  LOG(INFO) << "Added slave " << slaveId << " (" << slaves[slaveId].hostname
-            << ") with " << slaves[slaveId].total
-            << " (and " << slaves[slaveId].available << " available)";
+  changedSlaves.insert(slaveId);
 
-  allocate(slaveId);
+  // Capacity is relative to the largest slave, hence the keys of all
+  // slaves change once a larger one is added.
+  if (flags.placement != "random") {
+    const ScalarVector scalars(total);
+    bool grown = false;
+
+    for (int i = 0; i < ScalarVector::DIMENSIONS; i++) {
+      const double value = scalars.get(static_cast<ScalarVector::Index>(i));
+      if (value > fitReference[i]) {
+        fitReference[i] = value;
+        grown = true;
+      }
+    }
+
+    if (grown) {
+      foreachkey (const SlaveID& slaveId_, slaves) {
+        updateFitKey(slaveId_);
+      }
+    }
+  }
+
+  if (recoveredSlaves.contains(slaveId)) {
+    if (recoveredSlaves[slaveId].total != total) {
+      LOG(INFO) << "Slave " << slaveId << " re-registered with " << total
+                << " rather than the checkpointed "
+                << recoveredSlaves[slaveId].total;
+    }
+
+    recoveredSlaves.erase(slaveId);
+
+    if (recoveredSlaves.empty()) {
+      LOG(INFO) << "All slaves of the allocator checkpoint re-registered in "
+                << recovery.elapsed();
+    }
+
+    if (recovering && recoveryQuorum > 0) {
+      recoveryQuorum--;
+
+      if (recoveryQuorum == 0) {
+        endRecovery();
+      }
+    }
+  }
+
+  eventLog.addSlave(
+      slaveId,
+      slaves[slaveId].hostname,
+      slaves[slaveId].total,
+      available);
+
+  // See 'addFramework'.
+  if (!recovering) {
+    allocate(slaveId);
+  }
 }
 
 
@@ -463,10 +1107,31 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::removeSlave(
   // all the resources. Fixing this would require more information
   // than what we currently track in the allocator.
 
-  roleSorter->remove(slaves[slaveId].total.unreserved());
+  roleSorter->remove(slaves[slaveId].total.get().unreserved());
+
+  foreach (const Attribute& attribute, slaves[slaveId].attributes) {
+    const std::string key = attributeKey(attribute);
+
+    attributeIndex[key].erase(slaveId);
+    if (attributeIndex[key].empty()) {
+      attributeIndex.erase(key);
+    }
+  }
 
   slaves.erase(slaveId);
 
+  changedSlaves.insert(slaveId);
+
+  // Offers of a removed slave are rescinded.
+  if (flags.max_offers_per_framework > 0) {
+    foreachvalue (Framework& framework, frameworks) {
+      if (framework.offers.contains(slaveId)) {
+        framework.offerCount -= framework.offers[slaveId];
+        framework.offers.erase(slaveId);
+      }
+    }
+  }
+
   // Note that we DO NOT actually delete any filters associated with
   // this slave, that will occur when the delayed
   // HierarchicalAllocatorProcess::expire gets invoked (or the framework
@@ -486,6 +1151,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::activateSlave(
 
   slaves[slaveId].activated = true;
 
+  changedSlaves.insert(slaveId);
+
   LOG(INFO)<< "Slave " << slaveId << " reactivated";
 }
 
@@ -500,6 +1167,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::deactivateSlave(
 
   slaves[slaveId].activated = false;
 
+  changedSlaves.insert(slaveId);
+
   LOG(INFO) << "Slave " << slaveId << " deactivated";
 }
 
@@ -534,6 +1203,22 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::requestResources(
   CHECK(initialized);
 
   LOG(INFO) << "Received resource request from framework " << frameworkId;
+
+  if (!frameworks.contains(frameworkId)) {
+    return;
+  }
+
+  // The first request asking for scalar resources is taken as the
+  // shape of the framework's tasks.
+  foreach (const Request& request, requests) {
+    const Resources resources = request.resources();
+    const ScalarVector shape(resources);
+
+    if (!ScalarVector().contains(shape)) {
+      frameworks[frameworkId].taskShape = shape;
+      break;
+    }
+  }
 }
 
 
@@ -548,6 +1233,10 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateAllocation(
   CHECK(slaves.contains(slaveId));
   CHECK(frameworks.contains(frameworkId));
 
+  allocatePending(frameworkId);
+
+  resolveOffer(frameworkId, slaveId);
+
   // The total resources on the slave are composed of both allocated
   // and available resources:
   //
@@ -571,16 +1260,20 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateAllocation(
       allocation,
       updatedAllocation.get());
 
-  roleSorter->update(
+  roleUpdated(
       frameworks[frameworkId].role,
-      allocation.unreserved(),
-      updatedAllocation.get().unreserved());
+      allocation,
+      updatedAllocation.get());
 
   // Update the total resources.
-  Try<Resources> updatedTotal = slaves[slaveId].total.apply(operations);
+  Try<Resources> updatedTotal =
+    slaves[slaveId].total.get().apply(operations);
   CHECK_SOME(updatedTotal);
 
-  slaves[slaveId].total = updatedTotal.get();
+  slaves[slaveId].total = resourcesPool.intern(updatedTotal.get());
+
+  changedSlaves.insert(slaveId);
+  changedFrameworks.insert(frameworkId);
 
   // TODO(bmahler): Validate that the available resources are
   // unaffected. This requires augmenting the sorters with
@@ -590,9 +1283,8 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateAllocation(
   //            slaves[slaveId].available);
 
   // TODO(jieyu): Do not log if there is no update.
-  LOG(INFO) << "Updated allocation of framework " << frameworkId
-            << " on slave " << slaveId
-            << " from " << allocation << " to " << updatedAllocation.get();
+  eventLog.updateAllocation(
+      frameworkId, slaveId, allocation, updatedAllocation.get());
 }
 
 
@@ -606,10 +1298,16 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::recoverResources(
 {
   CHECK(initialized);
 
+  // Even if nothing is left of the offer.
+  resolveOffer(frameworkId, slaveId);
+
   if (resources.empty()) {
     return;
   }
 
+  // Revocable resources only return to the slave's estimate.
+  const Resources regular = resources.nonRevocable();
+
   // Updated resources allocated to framework (if framework still
   // exists, which it might not in the event that we dispatched
   // Master::offer before we received
@@ -621,23 +1319,35 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::recoverResources(
 
     CHECK(frameworkSorters.contains(role));
 
-    if (frameworkSorters[role]->contains(frameworkId.value())) {
-      frameworkSorters[role]->unallocated(frameworkId.value(), resources);
-      frameworkSorters[role]->remove(resources);
-      roleSorter->unallocated(role, resources.unreserved());
+    if (pendingAllocations.contains(frameworkId)) {
+      // Not added to the sorters yet.
+      pendingAllocations[frameworkId] -= regular;
+    } else if (frameworkSorters[role]->contains(frameworkId.value())) {
+      frameworkSorters[role]->unallocated(frameworkId.value(), regular);
+      frameworkSorters[role]->remove(regular);
+      roleUnallocated(role, regular);
     }
+
+    changedFrameworks.insert(frameworkId);
   }
 
   // Update resources allocatable on slave (if slave still exists,
   // which it might not in the event that we dispatched Master::offer
   // before we received Allocator::removeSlave).
   if (slaves.contains(slaveId)) {
-    slaves[slaveId].available += resources;
+    slaves[slaveId].available = resourcesPool.intern(
+        slaves[slaveId].available.get() + RangeResources::strip(regular));
+    slaves[slaveId].availableRanges += RangeResources(regular);
+    slaves[slaveId].allocatedRevocable -= resources.revocable();
 
-    LOG(INFO) << "Recovered " << resources
-              << " (total allocatable: " << slaves[slaveId].available
-              << ") on slave " << slaveId
-              << " from framework " << frameworkId;
+    changedSlaves.insert(slaveId);
+
+    eventLog.recoverResources(
+        frameworkId,
+        slaveId,
+        resources,
+        slaves[slaveId].available,
+        slaves[slaveId].availableRanges);
   }
 
   // No need to install the filter if 'filters' is none.
@@ -651,259 +1361,2083 @@ HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::recoverResources(
   }
 
   // Create a refused resources filter.
-  Try<Duration> seconds = Duration::create(filters.get().refuse_seconds());
-
-  if (seconds.isError()) {
-    LOG(WARNING) << "Using the default value of 'refuse_seconds' to create "
-                 << "the refused resources filter because the input value "
-                 << "is invalid: " << seconds.error();
-
-    seconds = Duration::create(Filters().refuse_seconds());
-  } else if (seconds.get() < Duration::zero()) {
-    LOG(WARNING) << "Using the default value of 'refuse_seconds' to create "
-                 << "the refused resources filter because the input value "
-                 << "is negative";
-
-    seconds = Duration::create(Filters().refuse_seconds());
-  }
-
-  CHECK_SOME(seconds);
-
-  if (seconds.get() != Duration::zero()) {
-    VLOG(1) << "Framework " << frameworkId
-            << " filtered slave " << slaveId
-            << " for " << seconds.get();
+  Duration seconds = refuseDuration(filters.get());
 
+  if (seconds != Duration::zero()) {
     // Create a new filter and delay its expiration.
-    Filter* filter = new RefusedFilter(
-        slaveId,
-        resources,
-        process::Timeout::in(seconds.get()));
+    Filter* filter = installFilter(frameworkId, slaveId, resources, seconds);
 
-    frameworks[frameworkId].filters.insert(filter);
-
-    delay(seconds.get(), self(), &Self::expire, frameworkId, filter);
+    delay(seconds, self(), &Self::expire, frameworkId, slaveId, filter);
   }
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::reviveOffers(
-    const FrameworkID& frameworkId)
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::bulkRecoverResources(
+    const std::vector<RecoveredResources>& recovered)
 {
   CHECK(initialized);
 
-  frameworks[frameworkId].filters.clear();
+  // The sorters and the slaves are updated once per framework and
+  // slave rather than once per recovered resources.
+  // Revocable resources only return to the slaves' estimates, see
+  // 'recoverResources'.
+  hashmap<FrameworkID, Resources> unallocated;
+  hashmap<SlaveID, Resources> available;
+  hashmap<SlaveID, Resources> revocable;
 
-  // We delete each actual Filter when
-  // HierarchicalAllocatorProcess::expire gets invoked. If we delete the
-  // Filter here it's possible that the same Filter (i.e., same
-  // address) could get reused and HierarchicalAllocatorProcess::expire
-  // would expire that filter too soon. Note that this only works
-  // right now because ALL Filter types "expire".
+  foreach (const RecoveredResources& recovered_, recovered) {
+    resolveOffer(recovered_.frameworkId, recovered_.slaveId);
 
-  LOG(INFO) << "Removed filters for framework " << frameworkId;
+    const Resources regular = recovered_.resources.nonRevocable();
 
-  allocate();
-}
+    unallocated[recovered_.frameworkId] += regular;
+    available[recovered_.slaveId] += regular;
+    revocable[recovered_.slaveId] += recovered_.resources.revocable();
+  }
 
+  // See 'recoverResources' for why frameworks and slaves might be
+  // gone already.
+  foreachpair (const FrameworkID& frameworkId,
+               const Resources& resources,
+               unallocated) {
+    if (resources.empty() || !frameworks.contains(frameworkId)) {
+      continue;
+    }
 
-template <class RoleSorter, class FrameworkSorter>
-void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::batch()
-{
-  allocate();
-  delay(allocationInterval, self(), &Self::batch);
-}
+    const std::string& role = frameworks[frameworkId].role;
+
+    CHECK(frameworkSorters.contains(role));
+
+    if (pendingAllocations.contains(frameworkId)) {
+      // Not added to the sorters yet.
+      pendingAllocations[frameworkId] -= resources;
+    } else if (frameworkSorters[role]->contains(frameworkId.value())) {
+      frameworkSorters[role]->unallocated(frameworkId.value(), resources);
+      frameworkSorters[role]->remove(resources);
+      roleUnallocated(role, resources);
+    }
+
+    changedFrameworks.insert(frameworkId);
+  }
+
+  foreachpair (const SlaveID& slaveId,
+               const Resources& resources,
+               available) {
+    if (resources.empty() || !slaves.contains(slaveId)) {
+      continue;
+    }
+
+    slaves[slaveId].available = resourcesPool.intern(
+        slaves[slaveId].available.get() + RangeResources::strip(resources));
+    slaves[slaveId].availableRanges += RangeResources(resources);
+
+    changedSlaves.insert(slaveId);
+  }
+
+  foreachpair (const SlaveID& slaveId,
+               const Resources& resources,
+               revocable) {
+    if (resources.empty() || !slaves.contains(slaveId)) {
+      continue;
+    }
+
+    slaves[slaveId].allocatedRevocable -= resources;
+
+    changedSlaves.insert(slaveId);
+  }
+
+  // Filters with the same timeout expire together.
+  std::map<Duration, std::vector<ExpiringFilter> > expiring;
+
+  foreach (const RecoveredResources& recovered_, recovered) {
+    const FrameworkID& frameworkId = recovered_.frameworkId;
+    const SlaveID& slaveId = recovered_.slaveId;
+
+    if (recovered_.resources.empty() || !slaves.contains(slaveId)) {
+      continue;
+    }
+
+    eventLog.recoverResources(
+        frameworkId,
+        slaveId,
+        recovered_.resources,
+        slaves[slaveId].available,
+        slaves[slaveId].availableRanges);
+
+    if (recovered_.filters.isNone() || !frameworks.contains(frameworkId)) {
+      continue;
+    }
+
+    Duration seconds = refuseDuration(recovered_.filters.get());
+
+    if (seconds != Duration::zero()) {
+      ExpiringFilter filter;
+      filter.frameworkId = frameworkId;
+      filter.slaveId = slaveId;
+      filter.filter =
+        installFilter(frameworkId, slaveId, recovered_.resources, seconds);
+
+      expiring[seconds].push_back(filter);
+    }
+  }
+
+  foreachpair (const Duration& seconds,
+               const std::vector<ExpiringFilter>& filters,
+               expiring) {
+    delay(seconds, self(), &Self::expireFilters, filters);
+  }
+}
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate()
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::reviveOffers(
+    const FrameworkID& frameworkId)
 {
-  Stopwatch stopwatch;
-  stopwatch.start();
+  CHECK(initialized);
 
-  allocate(slaves.keys());
+  frameworks[frameworkId].filters.clear();
+  frameworks[frameworkId].slaveFilters.clear();
 
-  VLOG(1) << "Performed allocation for " << slaves.size() << " slaves in "
-            << stopwatch.elapsed();
+  // We delete each actual Filter when
+  // HierarchicalAllocatorProcess::expire gets invoked. If we delete the
+  // Filter here it's possible that the same Filter (i.e., same
+  // address) could get reused and HierarchicalAllocatorProcess::expire
+  // would expire that filter too soon. Note that this only works
+  // right now because ALL Filter types "expire".
+
+  changedFrameworks.insert(frameworkId);
+
+  LOG(INFO) << "Removed filters for framework " << frameworkId;
+
+  if (frameworks[frameworkId].suppressed) {
+    frameworks[frameworkId].suppressed = false;
+    updateSorted(frameworkId);
+
+    LOG(INFO) << "Unsuppressed offers for framework " << frameworkId;
+  }
+
+  allocate();
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
-    const SlaveID& slaveId)
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::suppressOffers(
+    const FrameworkID& frameworkId)
 {
-  Stopwatch stopwatch;
-  stopwatch.start();
+  CHECK(initialized);
 
-  // TODO(bmahler): Add initializer list constructor for hashset.
-  hashset<SlaveID> slaves;
-  slaves.insert(slaveId);
-  allocate(slaves);
+  CHECK(frameworks.contains(frameworkId));
 
-  VLOG(1) << "Performed allocation for slave " << slaveId << " in "
-          << stopwatch.elapsed();
+  // The framework's allocation stays in the sorters, so that the
+  // shares of its role and of the other frameworks are unaffected.
+  frameworks[frameworkId].suppressed = true;
+  updateSorted(frameworkId);
+
+  changedFrameworks.insert(frameworkId);
+
+  LOG(INFO) << "Suppressed offers for framework " << frameworkId;
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
-    const hashset<SlaveID>& slaveIds_)
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addRole(
+    const std::string& role,
+    const mesos::master::RoleInfo& roleInfo)
 {
-  if (roleSorter->count() == 0) {
-    LOG(ERROR) << "No roles specified, cannot allocate resources!";
+  CHECK(initialized);
+
+  // Roles are also added along with their first framework, see
+  // 'addFramework', hence the operator may add one that exists.
+  if (roles.contains(role)) {
+    LOG(WARNING) << "Ignoring addition of existing role " << role
+                 << ", see 'updateWeights' to change its weight";
     return;
   }
 
-  // Compute the offerable resources, per framework:
-  //   (1) For reserved resources on the slave, allocate these to a
-  //       framework having the corresponding role.
-  //   (2) For unreserved resources on the slave, allocate these
-  //       to a framework of any role.
-  hashmap<FrameworkID, hashmap<SlaveID, Resources> > offerable;
+  roles[role] = roleInfo;
 
-  // Randomize the order in which slaves' resources are allocated.
-  // TODO(vinod): Implement a smarter sorting algorithm.
-  std::vector<SlaveID> slaveIds(slaveIds_.begin(), slaveIds_.end());
-  std::random_shuffle(slaveIds.begin(), slaveIds.end());
+  // Activated along with its first active framework.
+  roleSorter->add(role, roleInfo.weight());
+  roleSorter->deactivate(role);
 
-  foreach (const SlaveID& slaveId, slaveIds) {
-    // Don't send offers for non-whitelisted and deactivated slaves.
-    if (!isWhitelisted(slaveId) || !slaves[slaveId].activated) {
+  roleStats[role] = ClientStats(process::Clock::now());
+  addRoleGauges(role);
+
+  LOG(INFO) << "Added role " << role;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::removeRole(
+    const std::string& role)
+{
+  CHECK(initialized);
+
+  if (!roles.contains(role)) {
+    LOG(WARNING) << "Ignoring removal of unknown role " << role;
+    return;
+  }
+
+  // The framework sorter of a role exists as long as the role has
+  // frameworks.
+  if (frameworkSorters.contains(role)) {
+    LOG(WARNING) << "Ignoring removal of role " << role
+                 << " with frameworks";
+    return;
+  }
+
+  roleSorter->remove(role);
+  roles.erase(role);
+  quotas.erase(role);
+  unmetQuota.erase(role);
+
+  roleStats.erase(role);
+  removeGauges("allocator/roles/" + role + "/");
+
+  LOG(INFO) << "Removed role " << role;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateWeights(
+    const std::vector<mesos::master::RoleInfo>& roleInfos)
+{
+  CHECK(initialized);
+
+  foreach (const mesos::master::RoleInfo& roleInfo, roleInfos) {
+    const std::string& role = roleInfo.name();
+
+    if (!roles.contains(role)) {
+      LOG(WARNING) << "Ignoring weight of unknown role " << role;
       continue;
     }
 
-    foreach (const std::string& role, roleSorter->sort()) {
-      foreach (const std::string& frameworkId_,
-               frameworkSorters[role]->sort()) {
-        FrameworkID frameworkId;
-        frameworkId.set_value(frameworkId_);
+    if (roleInfo.weight() <= 0) {
+      LOG(WARNING) << "Ignoring invalid weight " << roleInfo.weight()
+                   << " of role " << role;
+      continue;
+    }
 
-        // NOTE: Currently, frameworks are allowed to have '*' role.
-        // Calling reserved('*') returns an empty Resources object.
-        Resources resources =
-          slaves[slaveId].available.unreserved() +
-          slaves[slaveId].available.reserved(role);
+    roles[role].set_weight(roleInfo.weight());
 
-        // If the resources are not allocatable, ignore.
-        if (!allocatable(resources)) {
-          continue;
-        }
+    // Only moves the role within the role sorter, the other roles
+    // keep their order.
+    roleSorter->updateWeight(role, roleInfo.weight());
 
-        // If the framework filters these resources, ignore.
-        if (isFiltered(frameworkId, slaveId, resources)) {
-          continue;
-        }
+    VLOG(1) << "Updated the weight of role " << role
+            << " to " << roleInfo.weight();
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::setQuota(
+    const std::string& role,
+    const Resources& guarantee)
+{
+  CHECK(initialized);
+
+  if (!roles.contains(role)) {
+    LOG(WARNING) << "Ignoring quota of unknown role " << role;
+    return;
+  }
 
-        VLOG(2) << "Allocating " << resources << " on slave " << slaveId
-                << " to framework " << frameworkId;
-
-        // Note that we perform "coarse-grained" allocation,
-        // meaning that we always allocate the entire remaining
-        // slave resources to a single framework.
-        offerable[frameworkId][slaveId] = resources;
-        slaves[slaveId].available -= resources;
-
-        // Reserved resources are only accounted for in the framework
-        // sorter, since the reserved resources are not shared across
-        // roles.
-        frameworkSorters[role]->add(resources);
-        frameworkSorters[role]->allocated(frameworkId_, resources);
-        roleSorter->allocated(role, resources.unreserved());
+  Quota quota;
+  quota.guaranteed = ScalarVector(guarantee);
+
+  // The current allocation is only summed up here, it is kept up to
+  // date incrementally afterwards.
+  if (frameworkSorters.contains(role)) {
+    foreachpair (const FrameworkID& frameworkId,
+                 const Framework& framework,
+                 frameworks) {
+      if (framework.role == role &&
+          frameworkSorters[role]->contains(frameworkId.value())) {
+        quota.allocated += ScalarVector(
+            frameworkSorters[role]->allocation(frameworkId.value()));
       }
     }
   }
 
-  if (offerable.empty()) {
-    VLOG(1) << "No resources available to allocate!";
-  } else {
-    // Now offer the resources to each framework.
-    foreachkey (const FrameworkID& frameworkId, offerable) {
-      offerCallback(frameworkId, offerable[frameworkId]);
-    }
+  quotas[role] = quota;
+  updateQuota(role);
+
+  LOG(INFO) << "Set quota of role " << role << " to " << guarantee;
+
+  allocate();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::removeQuota(
+    const std::string& role)
+{
+  CHECK(initialized);
+
+  quotas.erase(role);
+  unmetQuota.erase(role);
+
+  LOG(INFO) << "Removed quota of role " << role;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateSlave(
+    const SlaveID& slaveId,
+    const Resources& oversubscribed)
+{
+  CHECK(initialized);
+
+  if (!slaves.contains(slaveId)) {
+    LOG(WARNING) << "Ignoring oversubscribed resources of unknown slave "
+                 << slaveId;
+    return;
+  }
+
+  if (!oversubscribed.nonRevocable().empty()) {
+    LOG(WARNING) << "Ignoring non-revocable resources "
+                 << oversubscribed.nonRevocable()
+                 << " oversubscribed on slave " << slaveId;
   }
+
+  // The estimate replaces the previous one. Revocable resources
+  // allocated beyond it are not offered again until they are
+  // recovered, since they are going to be revoked by the slave.
+  slaves[slaveId].revocable = oversubscribed.revocable();
+
+  changedSlaves.insert(slaveId);
+
+  VLOG(1) << "Updated revocable resources of slave " << slaveId
+          << " to " << slaves[slaveId].revocable;
+
+  allocate(slaveId);
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
 void
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::expire(
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateConstraints(
     const FrameworkID& frameworkId,
-    Filter* filter)
+    const std::string& constraints)
 {
-  // The filter might have already been removed (e.g., if the
-  // framework no longer exists or in
-  // HierarchicalAllocatorProcess::reviveOffers) but not yet deleted (to
-  // keep the address from getting reused possibly causing premature
-  // expiration).
-  if (frameworks.contains(frameworkId) &&
-      frameworks[frameworkId].filters.contains(filter)) {
-    frameworks[frameworkId].filters.erase(filter);
+  CHECK(initialized);
+
+  if (!frameworks.contains(frameworkId)) {
+    LOG(WARNING) << "Ignoring constraints of unknown framework "
+                 << frameworkId;
+    return;
   }
 
-  delete filter;
+  // Constraints are matched the way slave attributes are indexed.
+  std::vector<std::string> keys;
+  foreach (const Attribute& attribute, Attributes::parse(constraints)) {
+    keys.push_back(attributeKey(attribute));
+  }
+
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+
+  Framework& framework = frameworks[frameworkId];
+  framework.constraints = keys;
+  framework.constraintsId.clear();
+
+  foreach (const std::string& key, keys) {
+    framework.constraintsId += key + ";";
+  }
+
+  LOG(INFO) << "Updated constraints of framework " << frameworkId
+            << " to '" << constraints << "'";
+
+  allocate();
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
-bool
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isWhitelisted(
-    const SlaveID& slaveId)
+Option<Error>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::checkUpdateAllocation( // NOLINT(whitespace/line_length)
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const std::vector<Offer::Operation>& operations)
 {
-  CHECK(slaves.contains(slaveId));
+  if (!frameworks.contains(frameworkId)) {
+    return Error("Unknown framework " + stringify(frameworkId));
+  }
 
-  return whitelist.isNone() ||
-         whitelist.get().contains(slaves[slaveId].hostname);
+  if (!slaves.contains(slaveId)) {
+    return Error("Unknown slave " + stringify(slaveId));
+  }
+
+  const Resources allocation = allocationOf(frameworkId);
+
+  Try<Resources> updatedAllocation = allocation.apply(operations);
+  if (updatedAllocation.isError()) {
+    return Error(
+        "Framework " + stringify(frameworkId) + " cannot apply operations"
+        " to its allocation " + stringify(allocation) + ": " +
+        updatedAllocation.error());
+  }
+
+  Try<Resources> updatedTotal = slaves[slaveId].total.get().apply(operations);
+  if (updatedTotal.isError()) {
+    return Error(
+        "Slave " + stringify(slaveId) + " cannot apply operations: " +
+        updatedTotal.error());
+  }
+
+  return None();
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
-bool
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isFiltered(
+Option<Error>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::checkRecoverResources( // NOLINT(whitespace/line_length)
     const FrameworkID& frameworkId,
     const SlaveID& slaveId,
     const Resources& resources)
 {
-  CHECK(frameworks.contains(frameworkId));
-  CHECK(slaves.contains(slaveId));
+  const Resources regular = resources.nonRevocable();
 
-  // Do not offer a non-checkpointing slave's resources to a checkpointing
-  // framework. This is a short term fix until the following is resolved:
-  // https://issues.apache.org/jira/browse/MESOS-444.
-  if (frameworks[frameworkId].checkpoint && !slaves[slaveId].checkpoint) {
-    VLOG(1) << "Filtered " << resources
-            << " on non-checkpointing slave " << slaveId
-            << " for checkpointing framework " << frameworkId;
-    return true;
+  // Like 'recoverResources', resources of removed frameworks and
+  // slaves are ignored.
+  if (frameworks.contains(frameworkId)) {
+    const Resources allocation = allocationOf(frameworkId);
+
+    if (!allocation.contains(regular)) {
+      return Error(
+          "Framework " + stringify(frameworkId) + " is not allocated " +
+          stringify(regular) + ", only " + stringify(allocation));
+    }
   }
 
-  foreach (Filter* filter, frameworks[frameworkId].filters) {
-    if (filter->filter(slaveId, resources)) {
-      VLOG(1) << "Filtered " << resources
-              << " on slave " << slaveId
-              << " for framework " << frameworkId;
-      return true;
+  if (slaves.contains(slaveId)) {
+    const Slave& slave = slaves[slaveId];
+
+    const Resources available =
+      slave.available.get() + slave.availableRanges.resources();
+
+    if (!slave.total.get().contains(available + regular)) {
+      return Error(
+          "Slave " + stringify(slaveId) + " would have " +
+          stringify(available + regular) + " available out of " +
+          stringify(slave.total.get()));
+    }
+
+    if (!slave.allocatedRevocable.contains(resources.revocable())) {
+      return Error(
+          "Slave " + stringify(slaveId) + " did not allocate " +
+          stringify(resources.revocable()));
     }
   }
-  return false;
+
+  return None();
 }
 
 
 template <class RoleSorter, class FrameworkSorter>
-bool
-HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocatable(
-    const Resources& resources)
+Resources
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocationOf(
+    const FrameworkID& frameworkId)
 {
-  Option<double> cpus = resources.cpus();
-  Option<Bytes> mem = resources.mem();
+  CHECK(frameworks.contains(frameworkId));
 
-  return (cpus.isSome() && cpus.get() >= MIN_CPUS) ||
-         (mem.isSome() && mem.get() >= MIN_MEM);
+  const std::string& role = frameworks[frameworkId].role;
+
+  Resources allocation =
+    pendingAllocations.get(frameworkId).getOrElse(Resources());
+
+  if (frameworkSorters[role]->contains(frameworkId.value())) {
+    allocation += frameworkSorters[role]->allocation(frameworkId.value());
+  }
+
+  return allocation;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::batch()
+{
+  if (flags.allocation_shards <= 1) {
+    allocate(slaves.keys());
+  } else {
+    // Only allocate from the slaves of the current shard.
+    hashset<SlaveID> slaveIds;
+    foreachkey (const SlaveID& slaveId, slaves) {
+      size_t hash = std::hash<SlaveID>()(slaveId);
+      if (static_cast<int>(hash % flags.allocation_shards) == shard) {
+        slaveIds.insert(slaveId);
+      }
+    }
+
+    allocate(slaveIds);
+
+    shard = (shard + 1) % flags.allocation_shards;
+  }
+
+  // Allocations triggered by events in between are not published:
+  // publishing goes through all roles and frameworks to refresh their
+  // shares, which is only affordable once per allocation interval.
+  if (!recovering) {
+    publish();
+  }
+
+  delay(allocationInterval, self(), &Self::batch);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate()
+{
+  if (flags.allocation_coalescing_window > Duration::zero()) {
+    allocateAll = true;
+
+    if (!allocationPending) {
+      allocationPending = true;
+      delay(flags.allocation_coalescing_window, self(), &Self::_allocate);
+    }
+
+    return;
+  }
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  allocate(slaves.keys());
+
+  VLOG(1) << "Performed allocation for " << slaves.size() << " slaves in "
+            << stopwatch.elapsed();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
+    const SlaveID& slaveId)
+{
+  if (flags.allocation_coalescing_window > Duration::zero()) {
+    allocationCandidates.insert(slaveId);
+
+    if (!allocationPending) {
+      allocationPending = true;
+      delay(flags.allocation_coalescing_window, self(), &Self::_allocate);
+    }
+
+    return;
+  }
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // TODO(bmahler): Add initializer list constructor for hashset.
+  hashset<SlaveID> slaves;
+  slaves.insert(slaveId);
+  allocate(slaves);
+
+  VLOG(1) << "Performed allocation for slave " << slaveId << " in "
+          << stopwatch.elapsed();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::_allocate()
+{
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  allocationPending = false;
+
+  // Slaves might have been removed during the coalescing window.
+  hashset<SlaveID> slaveIds;
+  if (allocateAll) {
+    slaveIds = slaves.keys();
+  } else {
+    foreach (const SlaveID& slaveId, allocationCandidates) {
+      if (slaves.contains(slaveId)) {
+        slaveIds.insert(slaveId);
+      }
+    }
+  }
+
+  allocationCandidates.clear();
+  allocateAll = false;
+
+  allocate(slaveIds);
+
+  VLOG(1) << "Performed coalesced allocation for " << slaveIds.size()
+          << " slaves in " << stopwatch.elapsed();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocate(
+    const hashset<SlaveID>& slaveIds_)
+{
+  // Offers are held back until the bulk recovery ends.
+  if (recovering) {
+    return;
+  }
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // Nothing to allocate unless some role has active frameworks.
+  if (activeRoles.empty()) {
+    return;
+  }
+
+  // Compute the offerable resources, per framework:
+  //   (1) For reserved resources on the slave, allocate these to a
+  //       framework having the corresponding role.
+  //   (2) For unreserved resources on the slave, allocate these
+  //       to a framework of any role.
+  hashmap<FrameworkID, hashmap<SlaveID, Resources> > offerable;
+
+  // Randomize the order in which slaves' resources are allocated.
+  // TODO(vinod): Implement a smarter sorting algorithm.
+  std::vector<SlaveID> slaveIds(slaveIds_.begin(), slaveIds_.end());
+  std::shuffle(slaveIds.begin(), slaveIds.end(), random);
+
+  // Time spent outside of the phases below, e.g. checking the budget,
+  // is accounted to slave ordering.
+  CycleStats stats;
+
+  // Passed over frameworks and roles start waiting for offers now.
+  const process::Time now = process::Clock::now();
+
+  // Only the slaves matching a framework's constraints are offered to
+  // it. These are looked up in the attribute index rather than
+  // matched against the attributes of each slave.
+  constrainedSlaves.clear();
+  stalledQuota.clear();
+  foreachvalue (const Framework& framework, frameworks) {
+    if (!framework.constraints.empty() &&
+        !constrainedSlaves.contains(framework.constraintsId)) {
+      constrainedSlaves[framework.constraintsId] =
+        matching(framework.constraints, slaveIds_);
+    }
+  }
+
+  // The capabilities required by every framework of a role in the
+  // sorter, which a slave must have to be of use to the role at all.
+  hashmap<std::string, uint32_t> roleRequirements;
+  foreachvalue (const Framework& framework, frameworks) {
+    if (!framework.sorted) {
+      continue;
+    }
+
+    if (!roleRequirements.contains(framework.role)) {
+      roleRequirements[framework.role] = framework.requiredCapabilities;
+    } else {
+      roleRequirements[framework.role] &= framework.requiredCapabilities;
+    }
+  }
+
+  // Unless slaves are placed randomly, every framework that requested
+  // resources is first offered the slave of the allocation its task
+  // shape fits best, in the order of the allocation below, which it
+  // then takes part in like any other framework. This packs small
+  // tasks onto the slaves already in use, keeping the capacity of the
+  // others for large tasks. The best fit is looked up in an index of
+  // the slaves by capacity, starting at the least capacity the shape
+  // could fit into, and giving up after 'FIT_SCAN_LIMIT' slaves.
+  if (flags.placement != "random") {
+    foreach (const SlaveID& slaveId, changedSlaves) {
+      updateFitKey(slaveId);
+    }
+
+    std::set<std::pair<double, std::string> > fitIndex;
+    foreach (const SlaveID& slaveId, slaveIds) {
+      if (isWhitelisted(slaveId) && slaves[slaveId].activated) {
+        fitIndex.insert(std::make_pair(fitKeys[slaveId], slaveId.value()));
+      }
+    }
+
+    foreach (const std::string& role, sortRoles(NULL)) {
+      foreach (const std::string& frameworkId_,
+               frameworkSorters[role]->sort()) {
+        FrameworkID frameworkId;
+        frameworkId.set_value(frameworkId_);
+
+        if (frameworks[frameworkId].taskShape.isNone()) {
+          continue;
+        }
+
+        stats.candidatesConsidered++;
+
+        if (flags.max_offers_per_framework > 0 &&
+            frameworks[frameworkId].offerCount >=
+              static_cast<size_t>(flags.max_offers_per_framework)) {
+          stats.candidatesCapped++;
+          skipped(frameworkId, CAPPED, now);
+          continue;
+        }
+
+        const ScalarVector& shape = frameworks[frameworkId].taskShape.get();
+
+        // The framework is passed over at most once for this pass, for
+        // the first reason met.
+        Option<SkipReason> reason;
+        bool placed = false;
+        size_t scanned = 0;
+
+        std::set<std::pair<double, std::string> >::const_iterator it =
+          fitIndex.lower_bound(std::make_pair(fitKey(shape), std::string()));
+
+        for (; it != fitIndex.end() && scanned < FIT_SCAN_LIMIT; ++it) {
+          scanned++;
+
+          SlaveID slaveId;
+          slaveId.set_value(it->second);
+
+          if ((frameworks[frameworkId].requiredCapabilities &
+               ~slaves[slaveId].capabilities) != 0) {
+            stats.candidatesPruned++;
+            continue;
+          }
+
+          if (isConstrained(frameworkId, slaveId)) {
+            if (reason.isNone()) {
+              reason = CONSTRAINED;
+            }
+            continue;
+          }
+
+          const Slave& slave = slaves[slaveId];
+
+          const Resources resources =
+            slave.available.get().unreserved() +
+            slave.available.get().reserved(role) +
+            slave.availableRanges.resources(role);
+
+          if (!ScalarVector(resources).contains(shape) ||
+              !allocatable(resources)) {
+            continue;
+          }
+
+          const SharedResources shared = resourcesPool.intern(resources);
+
+          if (isFiltered(frameworkId, slaveId, shared)) {
+            if (reason.isNone()) {
+              reason = FILTERED;
+            }
+            continue;
+          }
+
+          // Granting changes the slave's key, which moves it in the
+          // index and invalidates 'it'.
+          fitIndex.erase(it);
+          grant(frameworkId, slaveId, resources, &offerable, &stats);
+          fitIndex.insert(std::make_pair(fitKeys[slaveId], slaveId.value()));
+
+          stats.placements++;
+          placed = true;
+          break;
+        }
+
+        if (!placed && reason.isSome()) {
+          if (reason.get() == CONSTRAINED) {
+            stats.candidatesConstrained++;
+          } else {
+            stats.candidatesFiltered++;
+          }
+
+          skipped(frameworkId, reason.get(), now);
+        }
+      }
+    }
+
+    stats.mark(SORTER_UPDATES);
+  }
+
+  // Group the slaves into equivalence classes of slaves with the same
+  // available resources, including ranges, and capabilities.
+  // The resources offered to each role and whether they are
+  // allocatable are then computed once per class rather than once per
+  // slave and framework, and classes with nothing to offer are skipped
+  // as a whole. Since equal available resources share one interned
+  // copy, slaves are grouped by the address of that copy.
+  std::vector<EquivalenceClass> classes;
+  hashmap<const Resources*, std::vector<size_t> > shapes;
+  size_t eligible = 0;
+
+  foreach (const SlaveID& slaveId, slaveIds) {
+    // Don't send offers for non-whitelisted and deactivated slaves.
+    if (!isWhitelisted(slaveId) || !slaves[slaveId].activated) {
+      continue;
+    }
+
+    const Slave& slave = slaves[slaveId];
+    const Resources* shape = &slave.available.get();
+
+    Option<size_t> match;
+    foreach (size_t index, shapes[shape]) {
+      if (classes[index].capabilities == slave.capabilities &&
+          classes[index].availableRanges == slave.availableRanges) {
+        match = index;
+        break;
+      }
+    }
+
+    if (match.isNone()) {
+      match = classes.size();
+      classes.push_back(EquivalenceClass());
+      classes.back().available = slave.available;
+      classes.back().availableRanges = slave.availableRanges;
+      classes.back().capabilities = slave.capabilities;
+      shapes[shape].push_back(match.get());
+    }
+
+    classes[match.get()].slaveIds.push_back(slaveId);
+    eligible++;
+  }
+
+  // Slaves are still visited in random order within their class.
+  std::shuffle(classes.begin(), classes.end(), random);
+
+  stats.classes = classes.size();
+  stats.mark(SLAVE_ORDERING);
+
+  size_t visited = 0;
+  bool exceeded = false;
+
+  foreach (EquivalenceClass& class_, classes) {
+    if (exceeded) {
+      break;
+    }
+
+    // Compute the resources each role with active frameworks would be
+    // offered by a slave of this class, keeping only the allocatable
+    // ones.
+    // NOTE: Currently, frameworks are allowed to have '*' role, which
+    // has no reservations.
+    // The unreserved resources are split off once per class, only the
+    // reservations differ between the roles.
+    const Resources unreserved = class_.available.get().unreserved();
+    const hashmap<std::string, Resources> reserved =
+      class_.available.get().reserved();
+
+    hashmap<std::string, SharedResources> views;
+    foreachkey (const std::string& role, activeRoles) {
+      if ((roleRequirements[role] & ~class_.capabilities) != 0) {
+        continue;
+      }
+
+      Resources resources =
+        unreserved + class_.availableRanges.resources(role);
+
+      if (reserved.contains(role)) {
+        resources += reserved.get(role).get();
+      }
+
+      if (allocatable(resources)) {
+        views[role] = resourcesPool.intern(resources);
+      }
+    }
+
+    stats.mark(RESOURCE_VIEW);
+
+    if (views.empty()) {
+      visited += class_.slaveIds.size();
+      continue;
+    }
+
+    // The order of the frameworks of a role only changes with a grant
+    // to one of them, hence it is kept across the slaves of the class
+    // until then. The roles are sorted for every slave, as a grant
+    // changes the share of its role.
+    hashmap<std::string, std::list<std::string> > frameworkOrders;
+
+    foreach (const SlaveID& slaveId, class_.slaveIds) {
+      // Leave the remaining slaves to the next allocation once the
+      // budget is used up. Since slaves are shuffled, they are not
+      // starved.
+      if (flags.allocation_cycle_budget.isSome() &&
+          stopwatch.elapsed() > flags.allocation_cycle_budget.get()) {
+        VLOG(1) << "Allocation exceeded its budget of "
+                << flags.allocation_cycle_budget.get() << ", skipping "
+                << eligible - visited << " slaves";
+        exceeded = true;
+        break;
+      }
+
+      visited++;
+      stats.slavesVisited++;
+
+      // Whether the slave still has the resources of its class, i.e.,
+      // nothing has been allocated from it yet.
+      bool pristine = true;
+
+      hashset<std::string> prioritized;
+      const std::list<std::string> roles_ = sortRoles(&prioritized);
+      stats.mark(ROLE_SORT);
+
+      foreach (const std::string& role, roles_) {
+        // None of the role's frameworks can be offered the slave, which
+        // prunes all of them before looking at any resources.
+        if ((roleRequirements[role] & ~class_.capabilities) != 0) {
+          stats.candidatesPruned += activeRoles[role];
+          continue;
+        }
+
+        SharedResources resources;
+
+        if (pristine) {
+          if (!views.contains(role)) {
+            roleStats[role].skipped(UNALLOCATABLE, now);
+            continue;
+          }
+
+          resources = views[role];
+        } else if (!reserved.contains(role)) {
+          // Once the slave is granted, only the reservations of other
+          // roles are left on it, hence nothing allocatable is left
+          // for a role without reservations in the class.
+          roleStats[role].skipped(UNALLOCATABLE, now);
+          continue;
+        } else {
+          resources = resourcesPool.intern(
+              slaves[slaveId].available.get().unreserved() +
+              slaves[slaveId].available.get().reserved(role) +
+              slaves[slaveId].availableRanges.resources(role));
+
+          // If the resources are not allocatable, ignore.
+          if (!allocatable(resources)) {
+            roleStats[role].skipped(UNALLOCATABLE, now);
+            stats.mark(RESOURCE_VIEW);
+            continue;
+          }
+
+          stats.mark(RESOURCE_VIEW);
+        }
+
+        // Stalled unless a grant below gets the role closer to its
+        // quota, see 'grant'.
+        if (prioritized.contains(role)) {
+          stalledQuota.insert(role);
+        }
+
+        if (!frameworkOrders.contains(role)) {
+          frameworkOrders[role] = frameworkSorters[role]->sort();
+          stats.mark(FRAMEWORK_SORT);
+        }
+
+        foreach (const std::string& frameworkId_, frameworkOrders[role]) {
+          FrameworkID frameworkId;
+          frameworkId.set_value(frameworkId_);
+
+          if ((frameworks[frameworkId].requiredCapabilities &
+               ~class_.capabilities) != 0) {
+            stats.candidatesPruned++;
+            continue;
+          }
+
+          stats.candidatesConsidered++;
+
+          if (isConstrained(frameworkId, slaveId)) {
+            stats.mark(FILTER_CHECKS);
+            stats.candidatesConstrained++;
+            skipped(frameworkId, CONSTRAINED, now);
+            continue;
+          }
+
+          // Skip frameworks at their cap of outstanding offers before
+          // looking at their filters.
+          if (flags.max_offers_per_framework > 0 &&
+              frameworks[frameworkId].offerCount >=
+                static_cast<size_t>(flags.max_offers_per_framework)) {
+            stats.mark(FILTER_CHECKS);
+            stats.candidatesCapped++;
+            skipped(frameworkId, CAPPED, now);
+            continue;
+          }
+
+          // If the framework filters these resources, ignore.
+          if (isFiltered(frameworkId, slaveId, resources)) {
+            stats.mark(FILTER_CHECKS);
+            stats.candidatesFiltered++;
+            skipped(frameworkId, FILTERED, now);
+            continue;
+          }
+
+          stats.mark(FILTER_CHECKS);
+
+          // Note that we perform "coarse-grained" allocation,
+          // meaning that we always allocate the entire remaining
+          // slave resources to a single framework.
+          grant(frameworkId, slaveId, resources.get(), &offerable, &stats);
+          pristine = false;
+
+          // The grant changes the shares of all frameworks of the role,
+          // as it adds to the total they are relative to.
+          frameworkOrders.erase(role);
+
+          stats.mark(SORTER_UPDATES);
+
+          // Nothing allocatable is left for the other frameworks of
+          // this role, which would only be offered the resources
+          // reserved for other roles.
+          break;
+        }
+      }
+    }
+  }
+
+  // Offer the revocable resources of each slave to the framework
+  // first in the sort order among those accepting them. Since
+  // revocable resources are not accounted for in the sorters, they
+  // neither count towards the shares of the frameworks nor change the
+  // order. The grants of this pass are merged into the offers above.
+  foreach (const SlaveID& slaveId, slaveIds) {
+    if (exceeded) {
+      break;
+    }
+
+    Slave& slave = slaves[slaveId];
+
+    if (slave.revocable.empty() ||
+        !isWhitelisted(slaveId) ||
+        !slave.activated ||
+        !slave.revocable.contains(slave.allocatedRevocable)) {
+      continue;
+    }
+
+    const Resources available = slave.revocable - slave.allocatedRevocable;
+    if (!allocatable(available)) {
+      continue;
+    }
+
+    SharedResources resources = resourcesPool.intern(available);
+    Option<FrameworkID> chosen;
+
+    foreach (const std::string& role, roleSorter->sort()) {
+      foreach (const std::string& frameworkId_,
+               frameworkSorters[role]->sort()) {
+        FrameworkID frameworkId;
+        frameworkId.set_value(frameworkId_);
+
+        if (!frameworks[frameworkId].revocable) {
+          continue;
+        }
+
+        if ((frameworks[frameworkId].requiredCapabilities &
+             ~slave.capabilities) != 0) {
+          stats.candidatesPruned++;
+          continue;
+        }
+
+        stats.candidatesConsidered++;
+
+        if (isConstrained(frameworkId, slaveId)) {
+          stats.candidatesConstrained++;
+          continue;
+        }
+
+        // An offer of the slave to the framework in this allocation
+        // does not count against the cap again.
+        const bool offered = offerable.contains(frameworkId) &&
+          offerable[frameworkId].contains(slaveId);
+
+        if (flags.max_offers_per_framework > 0 &&
+            !offered &&
+            frameworks[frameworkId].offerCount >=
+              static_cast<size_t>(flags.max_offers_per_framework)) {
+          stats.candidatesCapped++;
+          continue;
+        }
+
+        if (isFiltered(frameworkId, slaveId, resources)) {
+          stats.candidatesFiltered++;
+          continue;
+        }
+
+        chosen = frameworkId;
+        break;
+      }
+
+      if (chosen.isSome()) {
+        break;
+      }
+    }
+
+    if (chosen.isNone()) {
+      continue;
+    }
+
+    const FrameworkID& frameworkId = chosen.get();
+
+    VLOG(2) << "Allocating revocable " << available
+            << " on slave " << slaveId
+            << " to framework " << frameworkId;
+
+    // The revocable resources join an offer of the same slave, if any.
+    if (flags.max_offers_per_framework > 0 &&
+        !(offerable.contains(frameworkId) &&
+          offerable[frameworkId].contains(slaveId))) {
+      frameworks[frameworkId].offers[slaveId]++;
+      frameworks[frameworkId].offerCount++;
+    }
+
+    offerable[frameworkId][slaveId] += available;
+    slave.allocatedRevocable += available;
+    changedSlaves.insert(slaveId);
+
+    frameworks[frameworkId].stats.offered(now);
+    roleStats[frameworks[frameworkId].role].offered(now);
+
+    stats.grants++;
+    stats.revocableGrants++;
+  }
+
+  // Frameworks and roles passed over in favor of others, e.g. with
+  // lower shares, wait from now on, like the ones skipped above.
+  if (!offerable.empty()) {
+    hashset<std::string> offeredRoles;
+    foreachkey (const FrameworkID& frameworkId, offerable) {
+      offeredRoles.insert(frameworks[frameworkId].role);
+    }
+
+    foreachpair (const FrameworkID& frameworkId,
+                 Framework& framework,
+                 frameworks) {
+      if (framework.sorted && !offerable.contains(frameworkId)) {
+        framework.stats.waiting(now);
+      }
+    }
+
+    foreachkey (const std::string& role, activeRoles) {
+      if (!offeredRoles.contains(role)) {
+        roleStats[role].waiting(now);
+      }
+    }
+  }
+
+  stats.mark(SLAVE_ORDERING);
+
+  if (offerable.empty()) {
+    VLOG(1) << "No resources available to allocate!";
+  } else {
+    // Now offer the resources to each framework.
+    foreachkey (const FrameworkID& frameworkId, offerable) {
+      offerCallback(frameworkId, offerable[frameworkId]);
+    }
+  }
+
+  stats.mark(OFFER_DELIVERY);
+
+  metrics.record(stats);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::expire(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    Filter* filter)
+{
+  // The filter might have already been removed (e.g., if the
+  // framework no longer exists or in
+  // HierarchicalAllocatorProcess::reviveOffers) but not yet deleted (to
+  // keep the address from getting reused possibly causing premature
+  // expiration).
+  if (frameworks.contains(frameworkId) &&
+      frameworks[frameworkId].filters.contains(filter)) {
+    Framework& framework = frameworks[frameworkId];
+
+    framework.filters.erase(filter);
+    changedFrameworks.insert(frameworkId);
+
+    if (framework.slaveFilters.contains(slaveId)) {
+      framework.slaveFilters[slaveId].erase(filter);
+
+      if (framework.slaveFilters[slaveId].empty()) {
+        framework.slaveFilters.erase(slaveId);
+      }
+    }
+  }
+
+  delete filter;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::expireFilters(
+    const std::vector<ExpiringFilter>& filters)
+{
+  foreach (const ExpiringFilter& filter, filters) {
+    expire(filter.frameworkId, filter.slaveId, filter.filter);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+Duration
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::refuseDuration(
+    const Filters& filters)
+{
+  Try<Duration> seconds = Duration::create(filters.refuse_seconds());
+
+  if (seconds.isError()) {
+    LOG(WARNING) << "Using the default value of 'refuse_seconds' to create "
+                 << "the refused resources filter because the input value "
+                 << "is invalid: " << seconds.error();
+
+    seconds = Duration::create(Filters().refuse_seconds());
+  } else if (seconds.get() < Duration::zero()) {
+    LOG(WARNING) << "Using the default value of 'refuse_seconds' to create "
+                 << "the refused resources filter because the input value "
+                 << "is negative";
+
+    seconds = Duration::create(Filters().refuse_seconds());
+  }
+
+  CHECK_SOME(seconds);
+
+  return seconds.get();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+Filter*
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::installFilter(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    const Duration& duration)
+{
+  CHECK(frameworks.contains(frameworkId));
+
+  VLOG(1) << "Framework " << frameworkId
+          << " filtered slave " << slaveId
+          << " for " << duration;
+
+  Filter* filter = new RefusedFilter(
+      slaveId,
+      resourcesPool.intern(resources),
+      process::Timeout::in(duration));
+
+  frameworks[frameworkId].filters.insert(filter);
+  changedFrameworks.insert(frameworkId);
+
+  if (flags.filter_index == "slave") {
+    frameworks[frameworkId].slaveFilters[slaveId].insert(filter);
+  }
+
+  return filter;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+bool
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isWhitelisted(
+    const SlaveID& slaveId)
+{
+  CHECK(slaves.contains(slaveId));
+
+  return whitelist.isNone() ||
+         whitelist.get().contains(slaves[slaveId].hostname);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+bool
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isFiltered(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const SharedResources& resources)
+{
+  CHECK(frameworks.contains(frameworkId));
+  CHECK(slaves.contains(slaveId));
+
+  // NOTE: Whether the slave has the capabilities the framework
+  // requires is checked before, see 'Capability'.
+
+  const Framework& framework = frameworks[frameworkId];
+
+  // With the slave index only the filters for this slave are checked.
+  if (flags.filter_index == "slave") {
+    if (!framework.slaveFilters.contains(slaveId)) {
+      return false;
+    }
+
+    foreach (Filter* filter, framework.slaveFilters.at(slaveId)) {
+      if (filter->filter(slaveId, resources)) {
+        VLOG(1) << "Filtered " << resources.get()
+                << " on slave " << slaveId
+                << " for framework " << frameworkId;
+        return true;
+      }
+    }
+
+    return false;
+  }
+
+  foreach (Filter* filter, framework.filters) {
+    if (filter->filter(slaveId, resources)) {
+      VLOG(1) << "Filtered " << resources.get()
+              << " on slave " << slaveId
+              << " for framework " << frameworkId;
+      return true;
+    }
+  }
+  return false;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+bool
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocatable(
+    const Resources& resources)
+{
+  Option<double> cpus = resources.cpus();
+  Option<Bytes> mem = resources.mem();
+
+  return (cpus.isSome() && cpus.get() >= MIN_CPUS) ||
+         (mem.isSome() && mem.get() >= MIN_MEM);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::resolveOffer(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId)
+{
+  if (flags.max_offers_per_framework <= 0 ||
+      !frameworks.contains(frameworkId) ||
+      !frameworks[frameworkId].offers.contains(slaveId)) {
+    return;
+  }
+
+  Framework& framework = frameworks[frameworkId];
+
+  framework.offerCount--;
+
+  if (--framework.offers[slaveId] == 0) {
+    framework.offers.erase(slaveId);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateSorted(
+    const FrameworkID& frameworkId)
+{
+  Framework& framework = frameworks[frameworkId];
+  const std::string& role = framework.role;
+
+  bool sorted = framework.active && !framework.suppressed;
+  if (sorted == framework.sorted) {
+    return;
+  }
+
+  framework.sorted = sorted;
+
+  if (sorted) {
+    frameworkSorters[role]->activate(frameworkId.value());
+
+    if (activeRoles[role]++ == 0) {
+      roleSorter->activate(role);
+    }
+  } else {
+    frameworkSorters[role]->deactivate(frameworkId.value());
+
+    if (--activeRoles[role] == 0) {
+      activeRoles.erase(role);
+      roleSorter->deactivate(role);
+    }
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::roleAllocated(
+    const std::string& role,
+    const Resources& resources)
+{
+  // Reserved resources are excluded from fairness across roles, but
+  // count towards the role's quota.
+  roleSorter->allocated(role, resources.unreserved());
+
+  if (quotas.contains(role)) {
+    quotas[role].allocated += ScalarVector(resources);
+    updateQuota(role);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::roleUnallocated(
+    const std::string& role,
+    const Resources& resources)
+{
+  roleSorter->unallocated(role, resources.unreserved());
+
+  if (quotas.contains(role)) {
+    quotas[role].allocated -= ScalarVector(resources);
+    updateQuota(role);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::roleUpdated(
+    const std::string& role,
+    const Resources& oldAllocation,
+    const Resources& newAllocation)
+{
+  roleSorter->update(
+      role,
+      oldAllocation.unreserved(),
+      newAllocation.unreserved());
+
+  if (quotas.contains(role)) {
+    quotas[role].allocated -= ScalarVector(oldAllocation);
+    quotas[role].allocated += ScalarVector(newAllocation);
+    updateQuota(role);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateQuota(
+    const std::string& role)
+{
+  const Quota& quota = quotas[role];
+
+  if (quota.allocated.contains(quota.guaranteed)) {
+    unmetQuota.erase(role);
+  } else {
+    unmetQuota.insert(role);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::grant(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    hashmap<FrameworkID, hashmap<SlaveID, Resources> >* offerable,
+    CycleStats* stats)
+{
+  const std::string& role = frameworks[frameworkId].role;
+
+  VLOG(2) << "Allocating " << resources
+          << " on slave " << slaveId
+          << " to framework " << frameworkId;
+
+  (*offerable)[frameworkId][slaveId] = resources;
+  slaves[slaveId].available = resourcesPool.intern(
+      slaves[slaveId].available.get() - RangeResources::strip(resources));
+  slaves[slaveId].availableRanges -= RangeResources(resources);
+  changedSlaves.insert(slaveId);
+
+  if (flags.placement != "random") {
+    updateFitKey(slaveId);
+  }
+
+  changedFrameworks.insert(frameworkId);
+
+  if (unmetQuota.contains(role)) {
+    stats->quotaGrants++;
+
+    if (quotas[role].helps(ScalarVector(resources))) {
+      stalledQuota.erase(role);
+    }
+  }
+
+  // Reserved resources are only accounted for in the framework
+  // sorter, since the reserved resources are not shared across roles.
+  frameworkSorters[role]->add(resources);
+  frameworkSorters[role]->allocated(frameworkId.value(), resources);
+  roleAllocated(role, resources);
+
+  if (flags.max_offers_per_framework > 0) {
+    frameworks[frameworkId].offers[slaveId]++;
+    frameworks[frameworkId].offerCount++;
+  }
+
+  const process::Time now = process::Clock::now();
+  frameworks[frameworkId].stats.offered(now);
+  roleStats[role].offered(now);
+
+  stats->grants++;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+double HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::fitKey(
+    const ScalarVector& scalars) const
+{
+  // A slave can only fit a shape if its key is at least the shape's,
+  // for both the sum and the maximum of the shares.
+  double key = 0;
+
+  for (int i = 0; i < ScalarVector::DIMENSIONS; i++) {
+    if (fitReference[i] > 0) {
+      const double share =
+        scalars.get(static_cast<ScalarVector::Index>(i)) / fitReference[i];
+
+      key = flags.placement == "dominant_fit"
+        ? std::max(key, share)
+        : key + share;
+    }
+  }
+
+  return key;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::updateFitKey(
+    const SlaveID& slaveId)
+{
+  if (slaves.contains(slaveId)) {
+    fitKeys[slaveId] =
+      fitKey(ScalarVector(slaves[slaveId].available.get()));
+  } else {
+    fitKeys.erase(slaveId);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+std::list<std::string>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::sortRoles(
+    hashset<std::string>* prioritized)
+{
+  std::list<std::string> roles_ = roleSorter->sort();
+
+  if (unmetQuota.empty()) {
+    return roles_;
+  }
+
+  std::list<std::string> unmet;
+
+  std::list<std::string>::iterator it = roles_.begin();
+  while (it != roles_.end()) {
+    std::list<std::string>::iterator next = it;
+    ++next;
+
+    if (unmetQuota.contains(*it) && !stalledQuota.contains(*it)) {
+      if (prioritized != NULL) {
+        prioritized->insert(*it);
+      }
+
+      unmet.splice(unmet.end(), roles_, it);
+    }
+
+    it = next;
+  }
+
+  roles_.splice(roles_.begin(), unmet);
+
+  return roles_;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+std::string
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::attributeKey(
+    const Attribute& attribute)
+{
+  switch (attribute.type()) {
+    case Value::SCALAR:
+      return attribute.name() + ":" + stringify(attribute.scalar());
+    case Value::RANGES:
+      return attribute.name() + ":" + stringify(attribute.ranges());
+    case Value::SET:
+      return attribute.name() + ":" + stringify(attribute.set());
+    case Value::TEXT:
+      return attribute.name() + ":" + attribute.text().value();
+  }
+
+  UNREACHABLE();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+hashset<SlaveID>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::matching(
+    const std::vector<std::string>& attributes,
+    const hashset<SlaveID>& slaveIds)
+{
+  hashset<SlaveID> result;
+
+  const hashset<SlaveID>* smallest = NULL;
+  foreach (const std::string& attribute, attributes) {
+    if (!attributeIndex.contains(attribute)) {
+      return result; // No slave has the attribute.
+    }
+
+    if (smallest == NULL ||
+        attributeIndex[attribute].size() < smallest->size()) {
+      smallest = &attributeIndex[attribute];
+    }
+  }
+
+  CHECK_NOTNULL(smallest);
+
+  foreach (const SlaveID& slaveId, *smallest) {
+    if (!slaveIds.contains(slaveId)) {
+      continue;
+    }
+
+    bool matches = true;
+    foreach (const std::string& attribute, attributes) {
+      if (!attributeIndex[attribute].contains(slaveId)) {
+        matches = false;
+        break;
+      }
+    }
+
+    if (matches) {
+      result.insert(slaveId);
+    }
+  }
+
+  return result;
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+bool HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::isConstrained(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId)
+{
+  const Framework& framework = frameworks[frameworkId];
+
+  return !framework.constraints.empty() &&
+         !constrainedSlaves[framework.constraintsId].contains(slaveId);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::skipped(
+    const FrameworkID& frameworkId,
+    SkipReason reason,
+    const process::Time& now)
+{
+  Framework& framework = frameworks[frameworkId];
+  framework.stats.skipped(reason, now);
+
+  if (roleStats.contains(framework.role)) {
+    roleStats[framework.role].skipped(reason, now);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addFrameworkGauges(
+    const FrameworkID& frameworkId)
+{
+  const std::string prefix =
+    "allocator/frameworks/" + frameworkId.value() + "/";
+
+  for (int i = 0; i < CLIENT_METRICS; i++) {
+    const ClientMetric metric = static_cast<ClientMetric>(i);
+
+    process::metrics::Gauge gauge(
+        prefix + ClientStats::name(metric),
+        lambda::bind(&Self::frameworkMetric, published, frameworkId, metric));
+
+    process::metrics::add(gauge);
+    gauges[prefix].push_back(gauge);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::addRoleGauges(
+    const std::string& role)
+{
+  const std::string prefix = "allocator/roles/" + role + "/";
+
+  for (int i = 0; i < CLIENT_METRICS; i++) {
+    const ClientMetric metric = static_cast<ClientMetric>(i);
+
+    process::metrics::Gauge gauge(
+        prefix + ClientStats::name(metric),
+        lambda::bind(&Self::roleMetric, published, role, metric));
+
+    process::metrics::add(gauge);
+    gauges[prefix].push_back(gauge);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::removeGauges(
+    const std::string& prefix)
+{
+  if (!gauges.contains(prefix)) {
+    return;
+  }
+
+  foreach (const process::metrics::Gauge& gauge, gauges[prefix]) {
+    process::metrics::remove(gauge);
+  }
+
+  gauges.erase(prefix);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+process::Future<double>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::frameworkMetric(
+    const std::shared_ptr<const Publication>& publication,
+    const FrameworkID& frameworkId,
+    ClientMetric metric)
+{
+  const std::shared_ptr<const Snapshot> snapshot = publication->get();
+
+  if (!snapshot->frameworks.contains(frameworkId)) {
+    return process::Failure("Unknown framework " + stringify(frameworkId));
+  }
+
+  return snapshot->frameworks.get(frameworkId).get()->stats.value(
+      metric, process::Clock::now());
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+process::Future<double>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::roleMetric(
+    const std::shared_ptr<const Publication>& publication,
+    const std::string& role,
+    ClientMetric metric)
+{
+  const std::shared_ptr<const Snapshot> snapshot = publication->get();
+
+  if (!snapshot->roles.contains(role)) {
+    return process::Failure("Unknown role '" + role + "'");
+  }
+
+  return snapshot->roles.get(role).get()->stats.value(
+      metric, process::Clock::now());
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+std::shared_ptr<const Snapshot>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::snapshot() const
+{
+  return published->get();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::publish()
+{
+  const std::shared_ptr<const Snapshot> previous = published->get();
+
+  std::shared_ptr<Snapshot> snapshot(new Snapshot());
+  snapshot->epoch = previous->epoch + 1;
+  snapshot->time = process::Clock::now();
+
+  // Copy-on-write: unchanged slaves keep sharing their entries with
+  // the previous snapshot.
+  snapshot->slaves = previous->slaves;
+
+  foreach (const SlaveID& slaveId, changedSlaves) {
+    if (!slaves.contains(slaveId)) {
+      snapshot->slaves.erase(slaveId);
+      continue;
+    }
+
+    const Slave& slave = slaves[slaveId];
+
+    std::shared_ptr<Snapshot::Slave> entry(new Snapshot::Slave());
+    entry->id = slaveId;
+    entry->hostname = slave.hostname;
+    entry->activated = slave.activated;
+    entry->checkpoint = (slave.capabilities & CHECKPOINTING) != 0;
+    entry->total = slave.total;
+    entry->available =
+      slave.available.get() + slave.availableRanges.resources();
+    entry->revocable = slave.revocable;
+
+    snapshot->slaves[slaveId] = entry;
+  }
+
+  changedSlaves.clear();
+
+  // The shares and stats of all roles and frameworks are refreshed,
+  // but entries are only rebuilt if they differ from the previous
+  // snapshot, so that unchanged ones keep being shared.
+  const hashmap<std::string, double> roleShares = roleSorter->shares();
+
+  foreachpair (const std::string& name,
+               const mesos::master::RoleInfo& roleInfo,
+               roles) {
+    const double share = roleShares.get(name).getOrElse(0.0);
+
+    roleStats[name].sample(share);
+    const ClientSummary stats = roleStats[name].summarize();
+
+    if (previous->roles.contains(name)) {
+      const std::shared_ptr<const Snapshot::Role>& entry =
+        previous->roles.get(name).get();
+
+      if (entry->weight == roleInfo.weight() &&
+          entry->share == share &&
+          entry->stats == stats) {
+        snapshot->roles[name] = entry;
+        continue;
+      }
+    }
+
+    std::shared_ptr<Snapshot::Role> entry(new Snapshot::Role());
+    entry->name = name;
+    entry->weight = roleInfo.weight();
+    entry->share = share;
+    entry->stats = stats;
+
+    snapshot->roles[name] = entry;
+  }
+
+  hashmap<std::string, hashmap<std::string, double> > frameworkShares;
+  foreachpair (const std::string& role,
+               FrameworkSorter* frameworkSorter,
+               frameworkSorters) {
+    frameworkShares[role] = frameworkSorter->shares();
+  }
+
+  foreachpair (const FrameworkID& frameworkId,
+               Framework& framework,
+               frameworks) {
+    const double share = frameworkShares[framework.role]
+      .get(frameworkId.value()).getOrElse(0.0);
+
+    framework.stats.sample(share);
+    const ClientSummary stats = framework.stats.summarize();
+
+    if (!changedFrameworks.contains(frameworkId) &&
+        previous->frameworks.contains(frameworkId)) {
+      const std::shared_ptr<const Snapshot::Framework>& entry =
+        previous->frameworks.get(frameworkId).get();
+
+      if (entry->share == share && entry->stats == stats) {
+        snapshot->frameworks[frameworkId] = entry;
+        continue;
+      }
+    }
+
+    std::shared_ptr<Snapshot::Framework> entry(new Snapshot::Framework());
+    entry->id = frameworkId;
+    entry->role = framework.role;
+    entry->checkpoint = framework.checkpoint;
+    entry->suppressed = framework.suppressed;
+    entry->share = share;
+    entry->filters = framework.filters.size();
+    entry->stats = stats;
+    entry->allocation =
+      frameworkSorters[framework.role]->allocation(frameworkId.value());
+
+    snapshot->frameworks[frameworkId] = entry;
+  }
+
+  changedFrameworks.clear();
+
+  published->set(snapshot);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::recover(
+    const checkpoint::State& state)
+{
+  foreachpair (const std::string& role, uint64_t count, state.roles) {
+    if (roleSorter->contains(role)) {
+      roleSorter->setAllocationCount(role, count);
+    }
+  }
+
+  recoveredFrameworks = state.frameworks;
+  recoveredSlaves = state.slaves;
+
+  recovery.start();
+
+  LOG(INFO) << "Recovered allocator checkpoint of "
+            << state.frameworks.size() << " frameworks and "
+            << state.slaves.size() << " slaves";
+
+  recoveryQuorum = static_cast<size_t>(
+      std::ceil(flags.recovery_quorum * state.slaves.size()));
+
+  if (recoveryQuorum > 0) {
+    recovering = true;
+
+    LOG(INFO) << "Deferring allocations until " << recoveryQuorum
+              << " slaves re-registered or " << flags.recovery_timeout
+              << " passed";
+
+    delay(flags.recovery_timeout, self(), &Self::endRecovery);
+  }
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::writeCheckpoint()
+{
+  CHECK_SOME(flags.checkpoint);
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  checkpoint::State state;
+  state.time = process::Clock::now().duration().ns();
+
+  foreachkey (const std::string& role, roles) {
+    state.roles[role] = roleSorter->allocationCount(role);
+  }
+
+  foreachpair (const FrameworkID& frameworkId,
+               const Framework& framework,
+               frameworks) {
+    checkpoint::State::Framework& entry = state.frameworks[frameworkId];
+    entry.role = framework.role;
+    entry.allocations = frameworkSorters[framework.role]
+      ->allocationCount(frameworkId.value());
+  }
+
+  foreachpair (const SlaveID& slaveId, const Slave& slave, slaves) {
+    checkpoint::State::Slave& entry = state.slaves[slaveId];
+    entry.hostname = slave.hostname;
+    entry.total = slave.total;
+  }
+
+  // Keep what has not been reconciled yet, in case the master fails
+  // over again before everything re-registered.
+  foreachpair (const FrameworkID& frameworkId,
+               const checkpoint::State::Framework& framework,
+               recoveredFrameworks) {
+    state.frameworks[frameworkId] = framework;
+  }
+
+  foreachpair (const SlaveID& slaveId,
+               const checkpoint::State::Slave& slave,
+               recoveredSlaves) {
+    state.slaves[slaveId] = slave;
+  }
+
+  checkpoint::save(flags.checkpoint.get(), state)
+    .onAny(defer(self(),
+                 &Self::checkpointed,
+                 lambda::_1,
+                 stopwatch,
+                 state.frameworks.size(),
+                 state.slaves.size()));
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::checkpointed(
+    const process::Future<Nothing>& write,
+    const Stopwatch& stopwatch,
+    size_t frameworks,
+    size_t slaves)
+{
+  if (!write.isReady()) {
+    LOG(WARNING) << "Failed to checkpoint allocator state: "
+                 << (write.isFailed() ? write.failure() : "discarded");
+  } else {
+    VLOG(1) << "Checkpointed allocator state of " << frameworks
+            << " frameworks and " << slaves << " slaves in "
+            << stopwatch.elapsed();
+  }
+
+  delay(flags.checkpoint_interval, self(), &Self::writeCheckpoint);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::endRecovery()
+{
+  // The timeout also fires if the quorum was reached before.
+  if (!recovering) {
+    return;
+  }
+
+  recovering = false;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  foreach (const FrameworkID& frameworkId, pendingAllocations.keys()) {
+    allocatePending(frameworkId);
+  }
+
+  LOG(INFO) << "Ended bulk recovery after " << recovery.elapsed() << " with "
+            << slaves.size() << " slaves and " << frameworks.size()
+            << " frameworks, added their allocations to the sorters in "
+            << stopwatch.elapsed();
+
+  allocate();
+  publish();
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+void HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::allocatePending(
+    const FrameworkID& frameworkId)
+{
+  if (!pendingAllocations.contains(frameworkId)) {
+    return;
+  }
+
+  CHECK(frameworks.contains(frameworkId));
+  const std::string& role = frameworks[frameworkId].role;
+
+  const Resources& allocation = pendingAllocations[frameworkId];
+
+  roleAllocated(role, allocation);
+  frameworkSorters[role]->add(allocation);
+  frameworkSorters[role]->allocated(frameworkId.value(), allocation);
+
+  pendingAllocations.erase(frameworkId);
+  changedFrameworks.insert(frameworkId);
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+process::Future<process::http::Response>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::cycles(
+    const process::http::Request& request)
+{
+  return process::http::OK(metrics.json(), request.query.get("jsonp"));
+}
+
+
+template <class RoleSorter, class FrameworkSorter>
+process::Future<process::http::Response>
+HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>::state(
+    const process::http::Request& request)
+{
+  return allocator::state::stream(snapshot());
 }
 
 } // namespace allocator {
@@ -0,0 +1,144 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_HISTOGRAM_HPP__
+#define __MASTER_ALLOCATOR_MESOS_HISTOGRAM_HPP__
+
+#include <stdint.h>
+#include <string.h>
+
+#include <algorithm>
+#include <limits>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// A fixed size histogram of non-negative integers in the spirit of
+// HdrHistogram: values are grouped into power-of-two buckets, each
+// split into 'SUB_BUCKETS' linear sub-buckets. Recording is O(1) and
+// percentiles are reported with a relative error below
+// 1 / 'SUB_BUCKETS', whatever the range of the values.
+class Histogram
+{
+public:
+  Histogram() { reset(); }
+
+  void record(uint64_t value)
+  {
+    counts[index(value)]++;
+    count_++;
+    sum += value;
+    min_ = std::min(min_, value);
+    max_ = std::max(max_, value);
+  }
+
+  void reset()
+  {
+    memset(counts, 0, sizeof(counts));
+    count_ = 0;
+    sum = 0;
+    min_ = std::numeric_limits<uint64_t>::max();
+    max_ = 0;
+  }
+
+  uint64_t count() const { return count_; }
+
+  uint64_t min() const { return count_ == 0 ? 0 : min_; }
+
+  uint64_t max() const { return max_; }
+
+  double mean() const
+  {
+    return count_ == 0 ? 0 : static_cast<double>(sum) / count_;
+  }
+
+  // Returns the highest value equivalent to the value at the given
+  // percentile, 'p' being in [0, 1].
+  uint64_t percentile(double p) const
+  {
+    if (count_ == 0) {
+      return 0;
+    }
+
+    uint64_t rank = static_cast<uint64_t>(p * count_ + 0.5);
+    rank = std::max<uint64_t>(1, std::min(rank, count_));
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < BUCKETS; i++) {
+      seen += counts[i];
+      if (seen >= rank) {
+        return std::min(highest(i), max_);
+      }
+    }
+
+    return max_;
+  }
+
+private:
+  enum
+  {
+    SUB_BUCKET_BITS = 3,
+    SUB_BUCKETS = 1 << SUB_BUCKET_BITS,
+
+    // Values below 'SUB_BUCKETS' are recorded exactly, every further
+    // power of two gets 'SUB_BUCKETS' sub-buckets.
+    BUCKETS = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS
+  };
+
+  static size_t index(uint64_t value)
+  {
+    if (value < SUB_BUCKETS) {
+      return value;
+    }
+
+    const size_t exponent = 63 - __builtin_clzll(value);
+    const size_t shift = exponent - SUB_BUCKET_BITS;
+    const size_t sub = (value >> shift) & (SUB_BUCKETS - 1);
+
+    return (shift + 1) * SUB_BUCKETS + sub;
+  }
+
+  // Returns the highest value that is recorded in the bucket.
+  static uint64_t highest(size_t index)
+  {
+    if (index < SUB_BUCKETS) {
+      return index;
+    }
+
+    const size_t shift = index / SUB_BUCKETS - 1;
+    const uint64_t sub = index % SUB_BUCKETS;
+    const uint64_t lowest = (SUB_BUCKETS + sub) << shift;
+
+    return lowest + ((static_cast<uint64_t>(1) << shift) - 1);
+  }
+
+  uint64_t counts[BUCKETS];
+  uint64_t count_;
+  uint64_t sum;
+  uint64_t min_;
+  uint64_t max_;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_HISTOGRAM_HPP__
@@ -0,0 +1,290 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+
+#include <glog/logging.h>
+
+#include <process/metrics/metrics.hpp>
+
+#include <stout/none.hpp>
+
+#include "mesos/metrics.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+static const char* PHASE_NAMES[PHASES] = {
+  "slave_ordering",
+  "role_sort",
+  "framework_sort",
+  "resource_view",
+  "filter_checks",
+  "sorter_updates",
+  "offer_delivery"
+};
+
+
+static const char* CLIENT_METRIC_NAMES[CLIENT_METRICS] = {
+  "seconds_since_offer",
+  "offer_latency_ms/p50",
+  "offer_latency_ms/p99",
+  "offer_latency_ms/max",
+  "consecutive_skips/filtered",
+  "consecutive_skips/capped",
+  "consecutive_skips/constrained",
+  "consecutive_skips/unallocatable",
+  "dominant_share",
+  "dominant_share/p50",
+  "dominant_share/max"
+};
+
+
+// Dominant shares are recorded as integers.
+static const double PARTS_PER_MILLION = 1000000;
+
+
+static JSON::Object summarize(const Histogram& histogram)
+{
+  JSON::Object object;
+  object.values["count"] = JSON::Number(histogram.count());
+  object.values["min"] = JSON::Number(histogram.min());
+  object.values["mean"] = JSON::Number(histogram.mean());
+  object.values["p50"] = JSON::Number(histogram.percentile(0.50));
+  object.values["p90"] = JSON::Number(histogram.percentile(0.90));
+  object.values["p99"] = JSON::Number(histogram.percentile(0.99));
+  object.values["p999"] = JSON::Number(histogram.percentile(0.999));
+  object.values["max"] = JSON::Number(histogram.max());
+  return object;
+}
+
+
+Metrics::Metrics()
+  : cycles("allocator/cycles"),
+    slavesVisited("allocator/slaves_visited"),
+    candidatesConsidered("allocator/candidates_considered"),
+    candidatesFiltered("allocator/candidates_filtered"),
+    candidatesCapped("allocator/candidates_capped"),
+    candidatesConstrained("allocator/candidates_constrained"),
+    candidatesPruned("allocator/candidates_pruned"),
+    grants("allocator/grants"),
+    quotaGrants("allocator/quota_grants"),
+    revocableGrants("allocator/revocable_grants"),
+    placements("allocator/placements")
+{
+  process::metrics::add(cycles);
+  process::metrics::add(slavesVisited);
+  process::metrics::add(candidatesConsidered);
+  process::metrics::add(candidatesFiltered);
+  process::metrics::add(candidatesCapped);
+  process::metrics::add(candidatesConstrained);
+  process::metrics::add(candidatesPruned);
+  process::metrics::add(grants);
+  process::metrics::add(quotaGrants);
+  process::metrics::add(revocableGrants);
+  process::metrics::add(placements);
+}
+
+
+Metrics::~Metrics()
+{
+  process::metrics::remove(cycles);
+  process::metrics::remove(slavesVisited);
+  process::metrics::remove(candidatesConsidered);
+  process::metrics::remove(candidatesFiltered);
+  process::metrics::remove(candidatesCapped);
+  process::metrics::remove(candidatesConstrained);
+  process::metrics::remove(candidatesPruned);
+  process::metrics::remove(grants);
+  process::metrics::remove(quotaGrants);
+  process::metrics::remove(revocableGrants);
+  process::metrics::remove(placements);
+}
+
+
+void Metrics::record(const CycleStats& stats)
+{
+  ++cycles;
+  slavesVisited += stats.slavesVisited;
+  candidatesConsidered += stats.candidatesConsidered;
+  candidatesFiltered += stats.candidatesFiltered;
+  candidatesCapped += stats.candidatesCapped;
+  candidatesConstrained += stats.candidatesConstrained;
+  candidatesPruned += stats.candidatesPruned;
+  grants += stats.grants;
+  quotaGrants += stats.quotaGrants;
+  revocableGrants += stats.revocableGrants;
+  placements += stats.placements;
+
+  uint64_t total = 0;
+  for (int phase = 0; phase < PHASES; phase++) {
+    phases[phase].record(stats.elapsed[phase]);
+    total += stats.elapsed[phase];
+  }
+
+  cycle.record(total);
+
+  classesPerCycle.record(stats.classes);
+  slavesVisitedPerCycle.record(stats.slavesVisited);
+  candidatesConsideredPerCycle.record(stats.candidatesConsidered);
+  candidatesFilteredPerCycle.record(stats.candidatesFiltered);
+  candidatesCappedPerCycle.record(stats.candidatesCapped);
+  candidatesConstrainedPerCycle.record(stats.candidatesConstrained);
+  candidatesPrunedPerCycle.record(stats.candidatesPruned);
+  grantsPerCycle.record(stats.grants);
+  quotaGrantsPerCycle.record(stats.quotaGrants);
+  revocableGrantsPerCycle.record(stats.revocableGrants);
+  placementsPerCycle.record(stats.placements);
+}
+
+
+JSON::Object Metrics::json() const
+{
+  JSON::Object durations;
+  for (int phase = 0; phase < PHASES; phase++) {
+    durations.values[PHASE_NAMES[phase]] = summarize(phases[phase]);
+  }
+  durations.values["cycle"] = summarize(cycle);
+
+  JSON::Object work;
+  work.values["classes"] = summarize(classesPerCycle);
+  work.values["slaves_visited"] = summarize(slavesVisitedPerCycle);
+  work.values["candidates_considered"] =
+    summarize(candidatesConsideredPerCycle);
+  work.values["candidates_filtered"] = summarize(candidatesFilteredPerCycle);
+  work.values["candidates_capped"] = summarize(candidatesCappedPerCycle);
+  work.values["candidates_constrained"] =
+    summarize(candidatesConstrainedPerCycle);
+  work.values["candidates_pruned"] = summarize(candidatesPrunedPerCycle);
+  work.values["grants"] = summarize(grantsPerCycle);
+  work.values["quota_grants"] = summarize(quotaGrantsPerCycle);
+  work.values["revocable_grants"] = summarize(revocableGrantsPerCycle);
+  work.values["placements"] = summarize(placementsPerCycle);
+
+  JSON::Object object;
+  object.values["cycles"] = JSON::Number(cycle.count());
+  object.values["durations_ns"] = durations;
+  object.values["per_cycle"] = work;
+
+  return object;
+}
+
+
+ClientSummary::ClientSummary()
+{
+  std::fill(values, values + CLIENT_METRICS, 0.0);
+}
+
+
+double ClientSummary::value(
+    ClientMetric metric,
+    const process::Time& now) const
+{
+  CHECK(metric < CLIENT_METRICS);
+
+  if (metric == SECONDS_SINCE_OFFER) {
+    return (now - lastOffer).secs();
+  }
+
+  return values[metric];
+}
+
+
+bool ClientSummary::operator==(const ClientSummary& that) const
+{
+  return lastOffer == that.lastOffer &&
+    std::equal(values, values + CLIENT_METRICS, that.values);
+}
+
+
+ClientStats::ClientStats(const process::Time& now)
+  : lastOffer(now), share(0)
+{
+  std::fill(skips, skips + SKIP_REASONS, 0);
+}
+
+
+void ClientStats::waiting(const process::Time& now)
+{
+  if (waitingSince.isNone()) {
+    waitingSince = now;
+  }
+}
+
+
+void ClientStats::skipped(SkipReason reason, const process::Time& now)
+{
+  skips[reason]++;
+  waiting(now);
+}
+
+
+void ClientStats::offered(const process::Time& now)
+{
+  // An offer without a preceding wait, e.g. the first one on a
+  // cluster with spare resources, says nothing about the latency.
+  if (waitingSince.isSome()) {
+    latency.record(static_cast<uint64_t>((now - waitingSince.get()).ms()));
+  }
+
+  waitingSince = None();
+  lastOffer = now;
+  std::fill(skips, skips + SKIP_REASONS, 0);
+}
+
+
+void ClientStats::sample(double share_)
+{
+  share = share_;
+  shares.record(static_cast<uint64_t>(share_ * PARTS_PER_MILLION));
+}
+
+
+ClientSummary ClientStats::summarize() const
+{
+  ClientSummary summary;
+  summary.lastOffer = lastOffer;
+
+  double* values = summary.values;
+  values[OFFER_LATENCY_MS_P50] = latency.percentile(0.50);
+  values[OFFER_LATENCY_MS_P99] = latency.percentile(0.99);
+  values[OFFER_LATENCY_MS_MAX] = latency.max();
+  values[SKIPPED_FILTERED] = skips[FILTERED];
+  values[SKIPPED_CAPPED] = skips[CAPPED];
+  values[SKIPPED_CONSTRAINED] = skips[CONSTRAINED];
+  values[SKIPPED_UNALLOCATABLE] = skips[UNALLOCATABLE];
+  values[DOMINANT_SHARE] = share;
+  values[DOMINANT_SHARE_P50] = shares.percentile(0.50) / PARTS_PER_MILLION;
+  values[DOMINANT_SHARE_MAX] = shares.max() / PARTS_PER_MILLION;
+
+  return summary;
+}
+
+
+const char* ClientStats::name(ClientMetric metric)
+{
+  CHECK(metric < CLIENT_METRICS);
+  return CLIENT_METRIC_NAMES[metric];
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
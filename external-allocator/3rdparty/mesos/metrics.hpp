@@ -0,0 +1,251 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_METRICS_HPP__
+#define __MASTER_ALLOCATOR_MESOS_METRICS_HPP__
+
+#include <stdint.h>
+
+#include <chrono>
+
+#include <process/time.hpp>
+
+#include <process/metrics/counter.hpp>
+
+#include <stout/json.hpp>
+#include <stout/option.hpp>
+
+#include "mesos/histogram.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// The phases of an allocation cycle.
+enum Phase
+{
+  SLAVE_ORDERING,
+  ROLE_SORT,
+  FRAMEWORK_SORT,
+  RESOURCE_VIEW,
+  FILTER_CHECKS,
+  SORTER_UPDATES,
+  OFFER_DELIVERY,
+  PHASES // Number of phases.
+};
+
+
+// Work done in one allocation cycle.
+struct CycleStats
+{
+  CycleStats()
+    : classes(0),
+      slavesVisited(0),
+      candidatesConsidered(0),
+      candidatesFiltered(0),
+      candidatesCapped(0),
+      candidatesConstrained(0),
+      candidatesPruned(0),
+      grants(0),
+      quotaGrants(0),
+      revocableGrants(0),
+      placements(0)
+  {
+    for (int phase = 0; phase < PHASES; phase++) {
+      elapsed[phase] = 0;
+    }
+
+    last = now();
+  }
+
+  // Attributes the time since the previous mark to the given phase.
+  // Costs a single clock read.
+  void mark(Phase phase)
+  {
+    const uint64_t time = now();
+    elapsed[phase] += time - last;
+    last = time;
+  }
+
+  static uint64_t now()
+  {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+  }
+
+  uint64_t elapsed[PHASES]; // Nanoseconds.
+  uint64_t last;
+
+  uint64_t classes; // Slave equivalence classes.
+  uint64_t slavesVisited;
+  uint64_t candidatesConsidered;
+  uint64_t candidatesFiltered;
+  uint64_t candidatesCapped; // At their cap of outstanding offers.
+  uint64_t candidatesConstrained; // On slaves their constraints exclude.
+  uint64_t candidatesPruned; // Lacking capabilities, never considered.
+  uint64_t grants;
+  uint64_t quotaGrants; // To roles short of their quota.
+  uint64_t revocableGrants; // Of revocable resources.
+  uint64_t placements; // Of slaves fit to task shapes, see '--placement'.
+};
+
+
+// Counters and per-cycle histograms of the allocation cycles. The
+// counters are exported through libprocess metrics, the histograms
+// through the allocator's '/cycles.json' endpoint.
+class Metrics
+{
+public:
+  Metrics();
+
+  ~Metrics();
+
+  void record(const CycleStats& stats);
+
+  JSON::Object json() const;
+
+private:
+  Metrics(const Metrics&); // Not copyable.
+  Metrics& operator=(const Metrics&); // Not assignable.
+
+  process::metrics::Counter cycles;
+  process::metrics::Counter slavesVisited;
+  process::metrics::Counter candidatesConsidered;
+  process::metrics::Counter candidatesFiltered;
+  process::metrics::Counter candidatesCapped;
+  process::metrics::Counter candidatesConstrained;
+  process::metrics::Counter candidatesPruned;
+  process::metrics::Counter grants;
+  process::metrics::Counter quotaGrants;
+  process::metrics::Counter revocableGrants;
+  process::metrics::Counter placements;
+
+  // Time spent in each phase and in the whole cycle, in nanoseconds.
+  Histogram phases[PHASES];
+  Histogram cycle;
+
+  Histogram classesPerCycle;
+  Histogram slavesVisitedPerCycle;
+  Histogram candidatesConsideredPerCycle;
+  Histogram candidatesFilteredPerCycle;
+  Histogram candidatesCappedPerCycle;
+  Histogram candidatesConstrainedPerCycle;
+  Histogram candidatesPrunedPerCycle;
+  Histogram grantsPerCycle;
+  Histogram quotaGrantsPerCycle;
+  Histogram revocableGrantsPerCycle;
+  Histogram placementsPerCycle;
+};
+
+
+// Why a framework or role was passed over for a slave it was a
+// candidate for.
+enum SkipReason
+{
+  FILTERED, // A refuse filter covers the resources.
+  CAPPED, // At its cap of outstanding offers.
+  CONSTRAINED, // Its constraints exclude the slave.
+  UNALLOCATABLE, // Nothing allocatable is left on the slave.
+  SKIP_REASONS // Number of reasons.
+};
+
+
+// The values of 'ClientStats' exported per framework and role.
+enum ClientMetric
+{
+  SECONDS_SINCE_OFFER,
+  OFFER_LATENCY_MS_P50,
+  OFFER_LATENCY_MS_P99,
+  OFFER_LATENCY_MS_MAX,
+  SKIPPED_FILTERED,
+  SKIPPED_CAPPED,
+  SKIPPED_CONSTRAINED,
+  SKIPPED_UNALLOCATABLE,
+  DOMINANT_SHARE,
+  DOMINANT_SHARE_P50,
+  DOMINANT_SHARE_MAX,
+  CLIENT_METRICS // Number of metrics.
+};
+
+
+// The values of a 'ClientStats' at some point in time, which can be
+// read from any thread.
+struct ClientSummary
+{
+  ClientSummary();
+
+  double value(ClientMetric metric, const process::Time& now) const;
+
+  bool operator==(const ClientSummary& that) const;
+
+  process::Time lastOffer;
+  double values[CLIENT_METRICS];
+};
+
+
+// How a framework or role is served, in constant memory, to spot
+// starvation: how long ago it was last offered resources, how long
+// it waited for offers since it was first passed over, how many times
+// in a row it has been passed over by reason, and its dominant share
+// over time.
+class ClientStats
+{
+public:
+  explicit ClientStats(const process::Time& now = process::Time());
+
+  // The client was passed over while resources were allocated, e.g.
+  // to clients with lower shares, hence it waits from now on unless
+  // it already does.
+  void waiting(const process::Time& now);
+
+  // The client was passed over for the given reason, which waits as
+  // well.
+  void skipped(SkipReason reason, const process::Time& now);
+
+  void offered(const process::Time& now);
+
+  void sample(double share);
+
+  ClientSummary summarize() const;
+
+  // Returns the name the metric is exported as, e.g.
+  // "offer_latency_ms/p99".
+  static const char* name(ClientMetric metric);
+
+private:
+  // When the client was last offered resources, or added.
+  process::Time lastOffer;
+
+  // When the client was first passed over since its last offer.
+  Option<process::Time> waitingSince;
+
+  uint64_t skips[SKIP_REASONS]; // Consecutive, since the last offer.
+
+  Histogram latency; // In milliseconds.
+
+  double share;
+  Histogram shares; // In parts per million.
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_METRICS_HPP__
@@ -0,0 +1,184 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <stout/foreach.hpp>
+
+#include "mesos/range_resources.hpp"
+
+using std::map;
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+RangeResources::RangeResources(const Resources& resources)
+{
+  foreach (const Resource& resource, resources) {
+    if (resource.type() != Value::RANGES) {
+      continue;
+    }
+
+    Resource prototype = resource;
+    prototype.clear_ranges();
+
+    Range& range = ranges[prototype.SerializeAsString()];
+    range.prototype = prototype;
+
+    foreach (const Value::Range& interval, resource.ranges().range()) {
+      range.set +=
+        (Bound<uint64_t>::closed(interval.begin()),
+         Bound<uint64_t>::closed(interval.end()));
+    }
+
+    if (range.set.empty()) {
+      ranges.erase(prototype.SerializeAsString());
+    }
+  }
+}
+
+
+Resources RangeResources::strip(const Resources& resources)
+{
+  Resources result;
+  foreach (const Resource& resource, resources) {
+    if (resource.type() != Value::RANGES) {
+      result += resource;
+    }
+  }
+
+  return result;
+}
+
+
+Resources RangeResources::resources() const
+{
+  Resources result;
+  foreachvalue (const Range& range, ranges) {
+    result += toResource(range);
+  }
+
+  return result;
+}
+
+
+Resources RangeResources::resources(const string& role) const
+{
+  Resources result;
+  foreachvalue (const Range& range, ranges) {
+    if (range.prototype.role() == "*" || range.prototype.role() == role) {
+      result += toResource(range);
+    }
+  }
+
+  return result;
+}
+
+
+bool RangeResources::contains(const RangeResources& that) const
+{
+  foreachpair (const string& key, const Range& range, that.ranges) {
+    map<string, Range>::const_iterator it = ranges.find(key);
+
+    if (it == ranges.end() || !it->second.set.contains(range.set)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool RangeResources::operator==(const RangeResources& that) const
+{
+  if (ranges.size() != that.ranges.size()) {
+    return false;
+  }
+
+  map<string, Range>::const_iterator it = ranges.begin();
+  map<string, Range>::const_iterator it_ = that.ranges.begin();
+
+  for (; it != ranges.end(); ++it, ++it_) {
+    if (it->first != it_->first || it->second.set != it_->second.set) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+
+bool RangeResources::operator!=(const RangeResources& that) const
+{
+  return !(*this == that);
+}
+
+
+RangeResources& RangeResources::operator+=(const RangeResources& that)
+{
+  foreachpair (const string& key, const Range& range, that.ranges) {
+    map<string, Range>::iterator it = ranges.find(key);
+
+    if (it == ranges.end()) {
+      ranges[key] = range;
+    } else {
+      it->second.set += range.set;
+    }
+  }
+
+  return *this;
+}
+
+
+RangeResources& RangeResources::operator-=(const RangeResources& that)
+{
+  foreachpair (const string& key, const Range& range, that.ranges) {
+    map<string, Range>::iterator it = ranges.find(key);
+
+    if (it != ranges.end()) {
+      it->second.set -= range.set;
+
+      if (it->second.set.empty()) {
+        ranges.erase(it);
+      }
+    }
+  }
+
+  return *this;
+}
+
+
+Resource RangeResources::toResource(const Range& range)
+{
+  Resource resource = range.prototype;
+
+  // NOTE: The upper bound of an 'Interval' is open.
+  foreach (const Interval<uint64_t>& interval, range.set) {
+    Value::Range* range_ = resource.mutable_ranges()->add_range();
+    range_->set_begin(interval.lower());
+    range_->set_end(interval.upper() - 1);
+  }
+
+  return resource;
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
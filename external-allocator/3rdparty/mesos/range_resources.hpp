@@ -0,0 +1,88 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_RANGE_RESOURCES_HPP__
+#define __MASTER_ALLOCATOR_MESOS_RANGE_RESOURCES_HPP__
+
+#include <stdint.h>
+
+#include <map>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <stout/interval.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// The range resources, e.g. ports, of some resources as interval
+// sets. Adding, subtracting and checking containment of fragmented
+// ranges is logarithmic in the number of fragments, while 'Resources'
+// compares and coalesces the individual ranges.
+//
+// Ranges are kept per resource, i.e., per name, role and reservation,
+// and are converted back to 'Resources' at the allocator's API
+// boundary.
+class RangeResources
+{
+public:
+  RangeResources() {}
+
+  // Ignores resources other than ranges.
+  explicit RangeResources(const Resources& resources);
+
+  // Returns the resources other than ranges.
+  static Resources strip(const Resources& resources);
+
+  Resources resources() const;
+
+  // Returns the unreserved ranges and those reserved for the role.
+  Resources resources(const std::string& role) const;
+
+  bool empty() const { return ranges.empty(); }
+
+  bool contains(const RangeResources& that) const;
+
+  bool operator==(const RangeResources& that) const;
+  bool operator!=(const RangeResources& that) const;
+
+  RangeResources& operator+=(const RangeResources& that);
+  RangeResources& operator-=(const RangeResources& that);
+
+private:
+  struct Range
+  {
+    Resource prototype; // The resource without its ranges.
+    IntervalSet<uint64_t> set;
+  };
+
+  static Resource toResource(const Range& range);
+
+  // Keyed by the serialized prototype.
+  std::map<std::string, Range> ranges;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_RANGE_RESOURCES_HPP__
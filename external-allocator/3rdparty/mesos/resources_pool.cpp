@@ -0,0 +1,210 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <algorithm>
+#include <string>
+
+#include <boost/functional/hash.hpp>
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+
+#include "mesos/resources_pool.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+SharedResources::SharedResources(Entry* _entry)
+  : entry(_entry)
+{
+  if (entry != NULL) {
+    entry->references++;
+  }
+}
+
+
+SharedResources::SharedResources(const SharedResources& that)
+  : entry(that.entry)
+{
+  if (entry != NULL) {
+    entry->references++;
+  }
+}
+
+
+SharedResources::~SharedResources()
+{
+  if (entry != NULL) {
+    entry->pool->release(entry);
+  }
+}
+
+
+SharedResources& SharedResources::operator=(const SharedResources& that)
+{
+  // Take the new reference first in case both refer to the same entry.
+  if (that.entry != NULL) {
+    that.entry->references++;
+  }
+
+  if (entry != NULL) {
+    entry->pool->release(entry);
+  }
+
+  entry = that.entry;
+
+  return *this;
+}
+
+
+const Resources& SharedResources::get() const
+{
+  static const Resources* empty = new Resources();
+
+  return entry != NULL ? entry->resources : *empty;
+}
+
+
+bool SharedResources::operator==(const SharedResources& that) const
+{
+  if (entry == that.entry) {
+    return true;
+  }
+
+  if (entry != NULL && that.entry != NULL && entry->pool == that.entry->pool) {
+    return false;
+  }
+
+  return get() == that.get();
+}
+
+
+bool SharedResources::operator!=(const SharedResources& that) const
+{
+  return !(*this == that);
+}
+
+
+bool SharedResources::contains(const SharedResources& that) const
+{
+  if (entry == that.entry) {
+    return true;
+  }
+
+  return get().contains(that.get());
+}
+
+
+SharedResources ResourcesPool::intern(const Resources& resources)
+{
+  const size_t hash_ = hash(resources);
+
+  vector<SharedResources::Entry*>& candidates = entries[hash_];
+
+  foreach (SharedResources::Entry* entry, candidates) {
+    if (entry->resources == resources) {
+      return SharedResources(entry);
+    }
+  }
+
+  SharedResources::Entry* entry = new SharedResources::Entry();
+  entry->resources = resources;
+  entry->hash = hash_;
+  entry->references = 0;
+  entry->pool = this;
+
+  candidates.push_back(entry);
+  count++;
+
+  return SharedResources(entry);
+}
+
+
+size_t ResourcesPool::hash(const Resources& resources)
+{
+  // Summing the hashes of the individual resources makes the hash
+  // independent of their order. Only the fields that usually tell
+  // resources apart are hashed, without serializing them, since the
+  // candidates are compared anyway.
+  size_t hash = 0;
+  foreach (const Resource& resource, resources) {
+    size_t seed = 0;
+    boost::hash_combine(seed, resource.name());
+    boost::hash_combine(seed, resource.role());
+    boost::hash_combine(seed, static_cast<int>(resource.type()));
+
+    switch (resource.type()) {
+      case Value::SCALAR:
+        boost::hash_combine(seed, resource.scalar().value());
+        break;
+      case Value::RANGES:
+        foreach (const Value::Range& range, resource.ranges().range()) {
+          boost::hash_combine(seed, range.begin());
+          boost::hash_combine(seed, range.end());
+        }
+        break;
+      case Value::SET:
+        // Sets are unordered as well.
+        foreach (const string& item, resource.set().item()) {
+          seed += boost::hash<string>()(item);
+        }
+        break;
+      case Value::TEXT:
+        break;
+    }
+
+    hash += seed;
+  }
+
+  return hash;
+}
+
+
+void ResourcesPool::release(SharedResources::Entry* entry)
+{
+  CHECK_GT(entry->references, 0u);
+
+  if (--entry->references > 0) {
+    return;
+  }
+
+  vector<SharedResources::Entry*>& candidates = entries[entry->hash];
+
+  candidates.erase(
+      std::remove(candidates.begin(), candidates.end(), entry),
+      candidates.end());
+
+  if (candidates.empty()) {
+    entries.erase(entry->hash);
+  }
+
+  count--;
+
+  delete entry;
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
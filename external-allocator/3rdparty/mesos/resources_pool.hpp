@@ -0,0 +1,118 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_RESOURCES_POOL_HPP__
+#define __MASTER_ALLOCATOR_MESOS_RESOURCES_POOL_HPP__
+
+#include <stddef.h>
+
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+#include <stout/hashmap.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Forward declaration.
+class ResourcesPool;
+
+
+// An immutable reference to resources interned in a 'ResourcesPool'.
+// Equal resources interned in the same pool share a single copy,
+// which is freed once the last reference to it goes away. A default
+// constructed reference refers to empty resources.
+//
+// NOTE: References are not thread-safe, they are meant to be used
+// from the allocator process only.
+class SharedResources
+{
+public:
+  SharedResources() : entry(NULL) {}
+
+  SharedResources(const SharedResources& that);
+
+  ~SharedResources();
+
+  SharedResources& operator=(const SharedResources& that);
+
+  const Resources& get() const;
+
+  operator const Resources&() const { return get(); }
+
+  // Resources interned in the same pool are equal if and only if they
+  // are the same copy, which makes comparing them O(1).
+  bool operator==(const SharedResources& that) const;
+  bool operator!=(const SharedResources& that) const;
+
+  bool contains(const SharedResources& that) const;
+
+private:
+  friend class ResourcesPool;
+
+  struct Entry
+  {
+    Resources resources;
+    size_t hash;
+    size_t references;
+    ResourcesPool* pool;
+  };
+
+  // Takes a reference to the entry.
+  explicit SharedResources(Entry* entry);
+
+  Entry* entry;
+};
+
+
+// Hash-consing store of resources, see 'SharedResources'. The pool
+// must outlive the references it hands out.
+class ResourcesPool
+{
+public:
+  ResourcesPool() : count(0) {}
+
+  SharedResources intern(const Resources& resources);
+
+  // Number of distinct resources in the pool.
+  size_t size() const { return count; }
+
+  // Hash of the resources independent of their order.
+  static size_t hash(const Resources& resources);
+
+private:
+  friend class SharedResources;
+
+  ResourcesPool(const ResourcesPool&); // Not copyable.
+  ResourcesPool& operator=(const ResourcesPool&); // Not assignable.
+
+  void release(SharedResources::Entry* entry);
+
+  hashmap<size_t, std::vector<SharedResources::Entry*> > entries;
+  size_t count;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_RESOURCES_POOL_HPP__
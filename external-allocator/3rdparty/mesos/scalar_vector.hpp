@@ -0,0 +1,252 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_SCALAR_VECTOR_HPP__
+#define __MASTER_ALLOCATOR_MESOS_SCALAR_VECTOR_HPP__
+
+#include <algorithm>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+#include <stout/foreach.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// The scalar quantities of some resources, regardless of their roles,
+// for the allocator's internal arithmetic. The common scalars are kept
+// in a fixed-size array, any other scalar in a small side table, so
+// that adding, subtracting and comparing the usual cpus/mem/disk does
+// not allocate nor compare names.
+//
+// NOTE: Non-scalar resources, e.g. ports, are not represented and
+// 'Resources' remain the type used at the allocator's API boundary.
+class ScalarVector
+{
+public:
+  enum Index
+  {
+    CPUS,
+    MEM,
+    DISK,
+    DIMENSIONS // Number of fixed dimensions.
+  };
+
+  ScalarVector()
+  {
+    std::fill(fixed, fixed + DIMENSIONS, 0.0);
+  }
+
+  explicit ScalarVector(const Resources& resources)
+  {
+    std::fill(fixed, fixed + DIMENSIONS, 0.0);
+
+    foreach (const Resource& resource, resources) {
+      if (resource.type() == Value::SCALAR) {
+        add(resource.name(), resource.scalar().value());
+      }
+    }
+  }
+
+  double get(Index index) const
+  {
+    return fixed[index];
+  }
+
+  double get(const std::string& name) const
+  {
+    int index_ = index(name);
+    if (index_ < DIMENSIONS) {
+      return fixed[index_];
+    }
+
+    for (size_t i = 0; i < others.size(); i++) {
+      if (others[i].first == name) {
+        return others[i].second;
+      }
+    }
+
+    return 0.0;
+  }
+
+  void add(const std::string& name, double value)
+  {
+    int index_ = index(name);
+    if (index_ < DIMENSIONS) {
+      fixed[index_] += value;
+      return;
+    }
+
+    for (size_t i = 0; i < others.size(); i++) {
+      if (others[i].first == name) {
+        others[i].second += value;
+        return;
+      }
+    }
+
+    others.push_back(std::make_pair(name, value));
+  }
+
+  ScalarVector& operator+=(const ScalarVector& that)
+  {
+    for (int i = 0; i < DIMENSIONS; i++) {
+      fixed[i] += that.fixed[i];
+    }
+
+    for (size_t i = 0; i < that.others.size(); i++) {
+      add(that.others[i].first, that.others[i].second);
+    }
+
+    return *this;
+  }
+
+  ScalarVector& operator-=(const ScalarVector& that)
+  {
+    for (int i = 0; i < DIMENSIONS; i++) {
+      fixed[i] -= that.fixed[i];
+    }
+
+    for (size_t i = 0; i < that.others.size(); i++) {
+      add(that.others[i].first, -that.others[i].second);
+    }
+
+    return *this;
+  }
+
+  ScalarVector operator+(const ScalarVector& that) const
+  {
+    ScalarVector result(*this);
+    result += that;
+    return result;
+  }
+
+  ScalarVector operator-(const ScalarVector& that) const
+  {
+    ScalarVector result(*this);
+    result -= that;
+    return result;
+  }
+
+  // Whether every quantity of 'that' is available in this vector.
+  bool contains(const ScalarVector& that) const
+  {
+    for (int i = 0; i < DIMENSIONS; i++) {
+      if (that.fixed[i] > fixed[i]) {
+        return false;
+      }
+    }
+
+    for (size_t i = 0; i < that.others.size(); i++) {
+      if (that.others[i].second > get(that.others[i].first)) {
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  // Returns the largest fraction of 'total' these quantities make up,
+  // only considering the scalars of which 'total' has a positive
+  // amount, i.e., the dominant share in DRF.
+  double dominantShare(const ScalarVector& total) const
+  {
+    double share = 0;
+
+    for (int i = 0; i < DIMENSIONS; i++) {
+      if (total.fixed[i] > 0) {
+        share = std::max(share, fixed[i] / total.fixed[i]);
+      }
+    }
+
+    for (size_t i = 0; i < total.others.size(); i++) {
+      if (total.others[i].second > 0) {
+        share = std::max(
+            share,
+            get(total.others[i].first) / total.others[i].second);
+      }
+    }
+
+    return share;
+  }
+
+  // Returns the positive quantities as unreserved resources, for
+  // callers of a sorter that only keeps the quantities, see
+  // 'TreeSorter'.
+  Resources resources() const
+  {
+    static const char* NAMES[DIMENSIONS] = { "cpus", "mem", "disk" };
+
+    Resources result;
+
+    for (int i = 0; i < DIMENSIONS; i++) {
+      if (fixed[i] > 0) {
+        result += scalar(NAMES[i], fixed[i]);
+      }
+    }
+
+    for (size_t i = 0; i < others.size(); i++) {
+      if (others[i].second > 0) {
+        result += scalar(others[i].first, others[i].second);
+      }
+    }
+
+    return result;
+  }
+
+private:
+  static Resource scalar(const std::string& name, double value)
+  {
+    Resource resource;
+    resource.set_name(name);
+    resource.set_type(Value::SCALAR);
+    resource.mutable_scalar()->set_value(value);
+    resource.set_role("*");
+    return resource;
+  }
+
+  // Returns 'DIMENSIONS' for scalars without a fixed index.
+  static int index(const std::string& name)
+  {
+    if (name == "cpus") {
+      return CPUS;
+    } else if (name == "mem") {
+      return MEM;
+    } else if (name == "disk") {
+      return DISK;
+    }
+
+    return DIMENSIONS;
+  }
+
+  double fixed[DIMENSIONS];
+
+  // Rare scalars, e.g. custom resources, by name.
+  std::vector<std::pair<std::string, double> > others;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_SCALAR_VECTOR_HPP__
@@ -0,0 +1,126 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_SNAPSHOT_HPP__
+#define __MASTER_ALLOCATOR_MESOS_SNAPSHOT_HPP__
+
+#include <stdint.h>
+
+#include <memory>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <process/time.hpp>
+
+#include <stout/hashmap.hpp>
+
+#include "mesos/metrics.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// An immutable copy of the allocator's state, published after every
+// batch allocation, i.e. once per allocation interval, so that it can
+// be read from any thread without going through the allocator
+// process. Snapshots are versioned by 'epoch'.
+//
+// Entries are shared between consecutive snapshots unless the slave,
+// framework or role changed in between, e.g. its share.
+struct Snapshot
+{
+  struct Slave
+  {
+    SlaveID id;
+    std::string hostname;
+    bool activated;
+    bool checkpoint;
+
+    Resources total;
+    Resources available;
+
+    // Estimated revocable resources, see 'updateSlave'.
+    Resources revocable;
+  };
+
+  struct Framework
+  {
+    FrameworkID id;
+    std::string role;
+    bool checkpoint;
+    bool suppressed;
+
+    Resources allocation;
+    double share;   // Within the role.
+    size_t filters; // Active refuse filters.
+
+    ClientSummary stats;
+  };
+
+  struct Role
+  {
+    std::string name;
+    double weight;
+    double share;
+
+    ClientSummary stats;
+  };
+
+  Snapshot() : epoch(0) {}
+
+  uint64_t epoch;
+  process::Time time;
+
+  hashmap<SlaveID, std::shared_ptr<const Slave> > slaves;
+  hashmap<FrameworkID, std::shared_ptr<const Framework> > frameworks;
+  hashmap<std::string, std::shared_ptr<const Role> > roles;
+};
+
+
+// Holds the latest snapshot. Readers which might outlive the
+// allocator, e.g. metrics gauges, share the ownership of the
+// publication rather than referring to the allocator.
+class Publication
+{
+public:
+  Publication() : snapshot(new Snapshot()) {}
+
+  std::shared_ptr<const Snapshot> get() const
+  {
+    return std::atomic_load(&snapshot);
+  }
+
+  void set(const std::shared_ptr<const Snapshot>& snapshot_)
+  {
+    std::atomic_store(&snapshot, snapshot_);
+  }
+
+private:
+  // NOTE: Only accessed through 'std::atomic_load' and
+  // 'std::atomic_store', since readers run on other threads.
+  std::shared_ptr<const Snapshot> snapshot;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_SNAPSHOT_HPP__
@@ -0,0 +1,332 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <iterator>
+#include <string>
+#include <thread>
+
+#include <glog/logging.h>
+
+#include <stout/duration.hpp>
+#include <stout/foreach.hpp>
+#include <stout/nothing.hpp>
+#include <stout/os.hpp>
+#include <stout/stringify.hpp>
+#include <stout/try.hpp>
+
+#include "picojson.h"
+
+#include "mesos/state.hpp"
+
+using std::string;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace state {
+
+// Buffered output is written once it reaches this size.
+static const size_t CHUNK = 64 * 1024;
+
+// A reader not taking any output for this long is given up on, which
+// ends its stream.
+static const Duration WRITE_TIMEOUT = Seconds(30);
+
+// Requests beyond this many concurrent streams are turned away.
+static const size_t MAX_STREAMS = 4;
+
+// Number of streams in flight, see 'stream'.
+static std::atomic<size_t> streams(0);
+
+
+// Buffers output and writes it to a non-blocking file descriptor in
+// chunks, waiting at most 'WRITE_TIMEOUT' for it to become writable.
+class Writer
+{
+public:
+  explicit Writer(int _fd) : fd(_fd), failed_(false)
+  {
+    buffer.reserve(CHUNK * 2);
+  }
+
+  void append(const char* data)
+  {
+    buffer += data;
+    if (buffer.size() >= CHUNK) {
+      flush();
+    }
+  }
+
+  void append(const picojson::value& value)
+  {
+    value.serialize(std::back_inserter(buffer));
+    if (buffer.size() >= CHUNK) {
+      flush();
+    }
+  }
+
+  void flush()
+  {
+    size_t offset = 0;
+    while (!failed_ && offset < buffer.size()) {
+      ssize_t length =
+        ::write(fd, buffer.data() + offset, buffer.size() - offset);
+
+      if (length < 0) {
+        if (errno == EINTR) {
+          continue;
+        }
+
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+          struct pollfd pollfd;
+          pollfd.fd = fd;
+          pollfd.events = POLLOUT;
+
+          int ready = ::poll(&pollfd, 1, WRITE_TIMEOUT.ms());
+          if (ready > 0 || (ready < 0 && errno == EINTR)) {
+            continue;
+          }
+
+          if (ready == 0) {
+            VLOG(1) << "Failed to stream allocator state: Timed out after "
+                    << WRITE_TIMEOUT << " waiting for the reader";
+            failed_ = true;
+            break;
+          }
+        }
+
+        // Most likely the client went away, which is not worth
+        // logging above verbosity 1.
+        VLOG(1) << "Failed to stream allocator state: " << strerror(errno);
+        failed_ = true;
+      } else {
+        offset += length;
+      }
+    }
+
+    buffer.clear();
+  }
+
+  bool failed() const { return failed_; }
+
+private:
+  const int fd;
+  bool failed_;
+  string buffer;
+};
+
+
+static picojson::value json(const Resources& resources)
+{
+  picojson::array array;
+
+  foreach (const Resource& resource, resources) {
+    picojson::object object;
+    object["name"] = picojson::value(resource.name());
+    object["role"] = picojson::value(resource.role());
+    object["type"] = picojson::value(Value::Type_Name(resource.type()));
+
+    if (resource.type() == Value::SCALAR) {
+      object["scalar"] = picojson::value(resource.scalar().value());
+    } else if (resource.type() == Value::RANGES) {
+      picojson::array ranges;
+      foreach (const Value::Range& range, resource.ranges().range()) {
+        picojson::array pair;
+        pair.push_back(picojson::value(static_cast<double>(range.begin())));
+        pair.push_back(picojson::value(static_cast<double>(range.end())));
+        ranges.push_back(picojson::value(pair));
+      }
+      object["ranges"] = picojson::value(ranges);
+    } else if (resource.type() == Value::SET) {
+      picojson::array items;
+      foreach (const string& item, resource.set().item()) {
+        items.push_back(picojson::value(item));
+      }
+      object["set"] = picojson::value(items);
+    }
+
+    array.push_back(picojson::value(object));
+  }
+
+  return picojson::value(array);
+}
+
+
+static picojson::value json(const Snapshot::Role& role)
+{
+  picojson::object object;
+  object["name"] = picojson::value(role.name);
+  object["weight"] = picojson::value(role.weight);
+  object["share"] = picojson::value(role.share);
+  return picojson::value(object);
+}
+
+
+static picojson::value json(const Snapshot::Framework& framework)
+{
+  picojson::object object;
+  object["id"] = picojson::value(framework.id.value());
+  object["role"] = picojson::value(framework.role);
+  object["checkpoint"] = picojson::value(framework.checkpoint);
+  object["suppressed"] = picojson::value(framework.suppressed);
+  object["allocation"] = json(framework.allocation);
+  object["share"] = picojson::value(framework.share);
+  object["filters"] =
+    picojson::value(static_cast<double>(framework.filters));
+  return picojson::value(object);
+}
+
+
+static picojson::value json(const Snapshot::Slave& slave)
+{
+  picojson::object object;
+  object["id"] = picojson::value(slave.id.value());
+  object["hostname"] = picojson::value(slave.hostname);
+  object["activated"] = picojson::value(slave.activated);
+  object["checkpoint"] = picojson::value(slave.checkpoint);
+  object["total"] = json(slave.total);
+  object["available"] = json(slave.available);
+  object["revocable"] = json(slave.revocable);
+  return picojson::value(object);
+}
+
+
+void write(const std::shared_ptr<const Snapshot>& snapshot, int fd)
+{
+  // Let writes to a closed connection fail with EPIPE rather than
+  // terminate the process.
+  sigset_t mask;
+  sigemptyset(&mask);
+  sigaddset(&mask, SIGPIPE);
+  pthread_sigmask(SIG_BLOCK, &mask, NULL);
+
+  Try<Nothing> nonblock = os::nonblock(fd);
+  if (nonblock.isError()) {
+    LOG(WARNING) << "Failed to stream allocator state: " << nonblock.error();
+    os::close(fd);
+    return;
+  }
+
+  Writer writer(fd);
+
+  writer.append("{\"epoch\":");
+  writer.append(stringify(snapshot->epoch).c_str());
+  writer.append(",\"time\":");
+  writer.append(stringify(snapshot->time.secs()).c_str());
+
+  writer.append(",\"roles\":[");
+  bool first = true;
+  foreachvalue (const std::shared_ptr<const Snapshot::Role>& role,
+                snapshot->roles) {
+    if (writer.failed()) {
+      break;
+    }
+
+    writer.append(first ? "" : ",");
+    writer.append(json(*role));
+    first = false;
+  }
+
+  writer.append("],\"frameworks\":[");
+  first = true;
+  foreachvalue (const std::shared_ptr<const Snapshot::Framework>& framework,
+                snapshot->frameworks) {
+    if (writer.failed()) {
+      break;
+    }
+
+    writer.append(first ? "" : ",");
+    writer.append(json(*framework));
+    first = false;
+  }
+
+  writer.append("],\"slaves\":[");
+  first = true;
+  foreachvalue (const std::shared_ptr<const Snapshot::Slave>& slave,
+                snapshot->slaves) {
+    if (writer.failed()) {
+      break;
+    }
+
+    writer.append(first ? "" : ",");
+    writer.append(json(*slave));
+    first = false;
+  }
+
+  writer.append("]}");
+  writer.flush();
+
+  os::close(fd);
+}
+
+
+static void _stream(const std::shared_ptr<const Snapshot>& snapshot, int fd)
+{
+  write(snapshot, fd);
+  streams--;
+}
+
+
+process::Future<process::http::Response> stream(
+    const std::shared_ptr<const Snapshot>& snapshot)
+{
+  // Every stream holds on to a thread and a snapshot until its reader
+  // is done, or times out, hence their number is bounded.
+  if (streams++ >= MAX_STREAMS) {
+    streams--;
+    return process::http::ServiceUnavailable(
+        "Too many concurrent requests for the allocator state");
+  }
+
+  int fds[2];
+  if (::pipe(fds) == -1) {
+    streams--;
+    return process::http::InternalServerError(
+        "Failed to create pipe: " + string(strerror(errno)));
+  }
+
+  os::cloexec(fds[0]);
+  os::cloexec(fds[1]);
+
+  // The snapshot is immutable, hence it can be serialized without
+  // holding up the allocator.
+  std::thread thread(&_stream, snapshot, fds[1]);
+  thread.detach();
+
+  process::http::OK response;
+  response.type = process::http::Response::PIPE;
+  response.pipe = fds[0];
+  response.headers["Content-Type"] = "application/json";
+
+  return response;
+}
+
+} // namespace state {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,55 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_STATE_HPP__
+#define __MASTER_ALLOCATOR_MESOS_STATE_HPP__
+
+#include <memory>
+
+#include <process/future.hpp>
+#include <process/http.hpp>
+
+#include "mesos/snapshot.hpp"
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace state {
+
+// Writes the snapshot as JSON to the file descriptor and closes it.
+// Roles, frameworks and slaves are serialized one at a time and
+// written in chunks, so that memory use does not grow with the size
+// of the snapshot. Stops early if the reader goes away, or does not
+// take any output for 30 seconds.
+void write(const std::shared_ptr<const Snapshot>& snapshot, int fd);
+
+
+// Returns a response streaming the snapshot from a separate thread,
+// see 'write', or 503 Service Unavailable if 4 streams are in flight
+// already.
+process::Future<process::http::Response> stream(
+    const std::shared_ptr<const Snapshot>& snapshot);
+
+} // namespace state {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_STATE_HPP__
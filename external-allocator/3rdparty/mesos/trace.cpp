@@ -0,0 +1,1188 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glog/logging.h>
+
+#include <process/clock.hpp>
+#include <process/delay.hpp>
+#include <process/dispatch.hpp>
+#include <process/future.hpp>
+#include <process/id.hpp>
+#include <process/process.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/error.hpp>
+#include <stout/foreach.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
+#include <stout/stringify.hpp>
+
+#include "mesos/allocator.hpp"
+#include "mesos/trace.hpp"
+
+using std::string;
+using std::vector;
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+namespace trace {
+
+// Flush the buffer once it grows beyond this size.
+static const size_t FLUSH_THRESHOLD = 64 * 1024;
+
+// Flush the buffer at least this often, whatever its size.
+static const Duration FLUSH_INTERVAL = Seconds(1);
+
+// Records are padded to this alignment.
+static const size_t ALIGNMENT = 8;
+
+
+static size_t padding(size_t size)
+{
+  return (ALIGNMENT - size % ALIGNMENT) % ALIGNMENT;
+}
+
+
+void Encoder::encode(uint8_t value)
+{
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+void Encoder::encode(uint32_t value)
+{
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+void Encoder::encode(int64_t value)
+{
+  buffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+
+void Encoder::encode(const string& value)
+{
+  encode(static_cast<uint32_t>(value.size()));
+  buffer.append(value);
+}
+
+
+void Encoder::encode(const google::protobuf::Message& message)
+{
+  encode(message.SerializeAsString());
+}
+
+
+void Encoder::encode(const Resources& resources)
+{
+  const google::protobuf::RepeatedPtrField<Resource>& resources_ = resources;
+
+  encode(static_cast<uint32_t>(resources_.size()));
+  foreach (const Resource& resource, resources_) {
+    encode(resource);
+  }
+}
+
+
+void Encoder::encode(const hashmap<SlaveID, Resources>& resources)
+{
+  encode(static_cast<uint32_t>(resources.size()));
+  foreachpair (const SlaveID& slaveId, const Resources& resources_, resources) {
+    encode(slaveId);
+    encode(resources_);
+  }
+}
+
+
+void Encoder::encode(const hashmap<FrameworkID, Resources>& resources)
+{
+  encode(static_cast<uint32_t>(resources.size()));
+  foreachpair (const FrameworkID& frameworkId,
+               const Resources& resources_,
+               resources) {
+    encode(frameworkId);
+    encode(resources_);
+  }
+}
+
+
+bool Decoder::read(void* destination, size_t length)
+{
+  if (size - position < length) {
+    return false;
+  }
+
+  memcpy(destination, data + position, length);
+  position += length;
+  return true;
+}
+
+
+bool Decoder::decode(uint8_t* value)
+{
+  return read(value, sizeof(*value));
+}
+
+
+bool Decoder::decode(uint32_t* value)
+{
+  return read(value, sizeof(*value));
+}
+
+
+bool Decoder::decode(int64_t* value)
+{
+  return read(value, sizeof(*value));
+}
+
+
+bool Decoder::decode(string* value)
+{
+  uint32_t length;
+  if (!decode(&length) || size - position < length) {
+    return false;
+  }
+
+  value->assign(data + position, length);
+  position += length;
+  return true;
+}
+
+
+bool Decoder::decode(google::protobuf::Message* message)
+{
+  uint32_t length;
+  if (!decode(&length) || size - position < length) {
+    return false;
+  }
+
+  if (!message->ParseFromArray(data + position, length)) {
+    return false;
+  }
+
+  position += length;
+  return true;
+}
+
+
+bool Decoder::decode(Resources* resources)
+{
+  uint32_t count;
+  if (!decode(&count)) {
+    return false;
+  }
+
+  google::protobuf::RepeatedPtrField<Resource> resources_;
+  for (uint32_t i = 0; i < count; i++) {
+    if (!decode(resources_.Add())) {
+      return false;
+    }
+  }
+
+  *resources = Resources(resources_);
+  return true;
+}
+
+
+bool Decoder::decode(hashmap<SlaveID, Resources>* resources)
+{
+  uint32_t count;
+  if (!decode(&count)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    SlaveID slaveId;
+    Resources resources_;
+    if (!decode(&slaveId) || !decode(&resources_)) {
+      return false;
+    }
+    (*resources)[slaveId] = resources_;
+  }
+
+  return true;
+}
+
+
+bool Decoder::decode(hashmap<FrameworkID, Resources>* resources)
+{
+  uint32_t count;
+  if (!decode(&count)) {
+    return false;
+  }
+
+  for (uint32_t i = 0; i < count; i++) {
+    FrameworkID frameworkId;
+    Resources resources_;
+    if (!decode(&frameworkId) || !decode(&resources_)) {
+      return false;
+    }
+    (*resources)[frameworkId] = resources_;
+  }
+
+  return true;
+}
+
+
+// Flushes a writer every 'FLUSH_INTERVAL' until terminated.
+class Flusher : public process::Process<Flusher>
+{
+public:
+  explicit Flusher(Writer* _writer)
+    : ProcessBase(process::ID::generate("allocator-trace-flusher")),
+      writer(_writer) {}
+
+protected:
+  virtual void initialize()
+  {
+    process::delay(FLUSH_INTERVAL, self(), &Flusher::flush);
+  }
+
+private:
+  void flush()
+  {
+    writer->flush();
+    process::delay(FLUSH_INTERVAL, self(), &Flusher::flush);
+  }
+
+  Writer* writer;
+};
+
+
+Try<Writer*> Writer::create(const string& path, uint32_t seed)
+{
+  Try<int> fd = os::open(
+      path,
+      O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,
+      S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+
+  if (fd.isError()) {
+    return Error("Failed to open trace file '" + path + "': " + fd.error());
+  }
+
+  Header header;
+  memcpy(header.magic, MAGIC, sizeof(header.magic));
+  header.version = VERSION;
+  header.seed = seed;
+
+  Writer* writer = new Writer(fd.get());
+  writer->buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  writer->flush();
+
+  writer->flusher = new Flusher(writer);
+  process::spawn(writer->flusher);
+
+  return writer;
+}
+
+
+Writer::~Writer()
+{
+  if (flusher != NULL) {
+    process::terminate(flusher);
+    process::wait(flusher);
+    delete flusher;
+  }
+
+  flush();
+
+  if (fd != -1) {
+    os::close(fd);
+  }
+}
+
+
+void Writer::initialize(
+    const Duration& allocationInterval,
+    const hashmap<string, mesos::master::RoleInfo>& roles)
+{
+  Encoder encoder;
+  encoder.encode(static_cast<int64_t>(allocationInterval.ns()));
+  encoder.encode(static_cast<uint32_t>(roles.size()));
+  foreachpair (const string& name,
+               const mesos::master::RoleInfo& roleInfo,
+               roles) {
+    encoder.encode(name);
+    encoder.encode(roleInfo);
+  }
+
+  append(INITIALIZE, encoder);
+}
+
+
+void Writer::addFramework(
+    const FrameworkID& frameworkId,
+    const FrameworkInfo& frameworkInfo,
+    const hashmap<SlaveID, Resources>& used)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+  encoder.encode(frameworkInfo);
+  encoder.encode(used);
+
+  append(ADD_FRAMEWORK, encoder);
+}
+
+
+void Writer::removeFramework(const FrameworkID& frameworkId)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+
+  append(REMOVE_FRAMEWORK, encoder);
+}
+
+
+void Writer::activateFramework(const FrameworkID& frameworkId)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+
+  append(ACTIVATE_FRAMEWORK, encoder);
+}
+
+
+void Writer::deactivateFramework(const FrameworkID& frameworkId)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+
+  append(DEACTIVATE_FRAMEWORK, encoder);
+}
+
+
+void Writer::addSlave(
+    const SlaveID& slaveId,
+    const SlaveInfo& slaveInfo,
+    const Resources& total,
+    const hashmap<FrameworkID, Resources>& used)
+{
+  Encoder encoder;
+  encoder.encode(slaveId);
+  encoder.encode(slaveInfo);
+  encoder.encode(total);
+  encoder.encode(used);
+
+  append(ADD_SLAVE, encoder);
+}
+
+
+void Writer::removeSlave(const SlaveID& slaveId)
+{
+  Encoder encoder;
+  encoder.encode(slaveId);
+
+  append(REMOVE_SLAVE, encoder);
+}
+
+
+void Writer::activateSlave(const SlaveID& slaveId)
+{
+  Encoder encoder;
+  encoder.encode(slaveId);
+
+  append(ACTIVATE_SLAVE, encoder);
+}
+
+
+void Writer::deactivateSlave(const SlaveID& slaveId)
+{
+  Encoder encoder;
+  encoder.encode(slaveId);
+
+  append(DEACTIVATE_SLAVE, encoder);
+}
+
+
+void Writer::updateWhitelist(const Option<hashset<string> >& whitelist)
+{
+  Encoder encoder;
+  encoder.encode(static_cast<uint8_t>(whitelist.isSome()));
+
+  if (whitelist.isSome()) {
+    encoder.encode(static_cast<uint32_t>(whitelist.get().size()));
+    foreach (const string& hostname, whitelist.get()) {
+      encoder.encode(hostname);
+    }
+  }
+
+  append(UPDATE_WHITELIST, encoder);
+}
+
+
+void Writer::requestResources(
+    const FrameworkID& frameworkId,
+    const vector<Request>& requests)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+  encoder.encode(static_cast<uint32_t>(requests.size()));
+  foreach (const Request& request, requests) {
+    encoder.encode(request);
+  }
+
+  append(REQUEST_RESOURCES, encoder);
+}
+
+
+void Writer::updateAllocation(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const vector<Offer::Operation>& operations)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+  encoder.encode(slaveId);
+  encoder.encode(static_cast<uint32_t>(operations.size()));
+  foreach (const Offer::Operation& operation, operations) {
+    encoder.encode(operation);
+  }
+
+  append(UPDATE_ALLOCATION, encoder);
+}
+
+
+void Writer::recoverResources(
+    const FrameworkID& frameworkId,
+    const SlaveID& slaveId,
+    const Resources& resources,
+    const Option<Filters>& filters)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+  encoder.encode(slaveId);
+  encoder.encode(resources);
+  encoder.encode(static_cast<uint8_t>(filters.isSome()));
+
+  if (filters.isSome()) {
+    encoder.encode(filters.get());
+  }
+
+  append(RECOVER_RESOURCES, encoder);
+}
+
+
+void Writer::reviveOffers(const FrameworkID& frameworkId)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+
+  append(REVIVE_OFFERS, encoder);
+}
+
+
+void Writer::bulkRecoverResources(const vector<RecoveredResources>& recovered)
+{
+  Encoder encoder;
+  encoder.encode(static_cast<uint32_t>(recovered.size()));
+
+  foreach (const RecoveredResources& recovered_, recovered) {
+    encoder.encode(recovered_.frameworkId);
+    encoder.encode(recovered_.slaveId);
+    encoder.encode(recovered_.resources);
+    encoder.encode(static_cast<uint8_t>(recovered_.filters.isSome()));
+
+    if (recovered_.filters.isSome()) {
+      encoder.encode(recovered_.filters.get());
+    }
+  }
+
+  append(BULK_RECOVER_RESOURCES, encoder);
+}
+
+
+void Writer::suppressOffers(const FrameworkID& frameworkId)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+
+  append(SUPPRESS_OFFERS, encoder);
+}
+
+
+void Writer::addRole(
+    const string& role,
+    const mesos::master::RoleInfo& roleInfo)
+{
+  Encoder encoder;
+  encoder.encode(role);
+  encoder.encode(roleInfo);
+
+  append(ADD_ROLE, encoder);
+}
+
+
+void Writer::removeRole(const string& role)
+{
+  Encoder encoder;
+  encoder.encode(role);
+
+  append(REMOVE_ROLE, encoder);
+}
+
+
+void Writer::updateWeights(const vector<mesos::master::RoleInfo>& roleInfos)
+{
+  Encoder encoder;
+  encoder.encode(static_cast<uint32_t>(roleInfos.size()));
+
+  foreach (const mesos::master::RoleInfo& roleInfo, roleInfos) {
+    encoder.encode(roleInfo);
+  }
+
+  append(UPDATE_WEIGHTS, encoder);
+}
+
+
+void Writer::setQuota(const string& role, const Resources& guarantee)
+{
+  Encoder encoder;
+  encoder.encode(role);
+  encoder.encode(guarantee);
+
+  append(SET_QUOTA, encoder);
+}
+
+
+void Writer::removeQuota(const string& role)
+{
+  Encoder encoder;
+  encoder.encode(role);
+
+  append(REMOVE_QUOTA, encoder);
+}
+
+
+void Writer::updateSlave(
+    const SlaveID& slaveId,
+    const Resources& oversubscribed)
+{
+  Encoder encoder;
+  encoder.encode(slaveId);
+  encoder.encode(oversubscribed);
+
+  append(UPDATE_SLAVE, encoder);
+}
+
+
+void Writer::updateConstraints(
+    const FrameworkID& frameworkId,
+    const string& constraints)
+{
+  Encoder encoder;
+  encoder.encode(frameworkId);
+  encoder.encode(constraints);
+
+  append(UPDATE_CONSTRAINTS, encoder);
+}
+
+
+void Writer::flush()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  _flush();
+}
+
+
+void Writer::append(Type type, const Encoder& encoder)
+{
+  RecordHeader header;
+  header.size = static_cast<uint32_t>(encoder.data().size());
+  header.type = type;
+  header.timestamp = process::Clock::now().duration().ns();
+
+  static const char zeros[ALIGNMENT] = {};
+
+  std::lock_guard<std::mutex> lock(mutex);
+
+  buffer.append(reinterpret_cast<const char*>(&header), sizeof(header));
+  buffer.append(encoder.data());
+  buffer.append(zeros, padding(encoder.data().size()));
+
+  if (buffer.size() >= FLUSH_THRESHOLD) {
+    _flush();
+  }
+}
+
+
+void Writer::_flush()
+{
+  if (fd == -1) {
+    buffer.clear();
+    return;
+  }
+
+  size_t offset = 0;
+  while (offset < buffer.size()) {
+    ssize_t length =
+      ::write(fd, buffer.data() + offset, buffer.size() - offset);
+
+    if (length < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (length < 0) {
+      // Stop tracing rather than failing the master.
+      PLOG(ERROR) << "Failed to write allocator trace, disabling tracing";
+      os::close(fd);
+      fd = -1;
+      break;
+    }
+
+    offset += length;
+  }
+
+  buffer.clear();
+}
+
+
+Try<Reader*> Reader::create(const string& path)
+{
+  Try<int> fd = os::open(path, O_RDONLY | O_CLOEXEC);
+  if (fd.isError()) {
+    return Error("Failed to open trace file '" + path + "': " + fd.error());
+  }
+
+  struct stat s;
+  if (::fstat(fd.get(), &s) < 0) {
+    ErrnoError error("Failed to stat trace file '" + path + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  size_t size = s.st_size;
+
+  if (size < sizeof(Header)) {
+    os::close(fd.get());
+    return Error("Trace file '" + path + "' is too short");
+  }
+
+  void* data = ::mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd.get(), 0);
+  if (data == MAP_FAILED) {
+    ErrnoError error("Failed to mmap trace file '" + path + "'");
+    os::close(fd.get());
+    return error;
+  }
+
+  // Records are read sequentially.
+  ::madvise(data, size, MADV_SEQUENTIAL);
+
+  const Header* header = static_cast<const Header*>(data);
+  if (memcmp(header->magic, MAGIC, sizeof(MAGIC)) != 0 ||
+      header->version != VERSION) {
+    ::munmap(data, size);
+    os::close(fd.get());
+    return Error("Trace file '" + path + "' has an unsupported format");
+  }
+
+  return new Reader(fd.get(), static_cast<const char*>(data), size);
+}
+
+
+uint32_t Reader::seed() const
+{
+  return reinterpret_cast<const Header*>(data)->seed;
+}
+
+
+Reader::~Reader()
+{
+  ::munmap(const_cast<char*>(data), size);
+  os::close(fd);
+}
+
+
+Result<Record> Reader::next()
+{
+  if (position == size) {
+    return None();
+  }
+
+  if (size - position < sizeof(RecordHeader)) {
+    return Error("Truncated record header at offset " + stringify(position));
+  }
+
+  const RecordHeader* header =
+    reinterpret_cast<const RecordHeader*>(data + position);
+
+  size_t length = sizeof(RecordHeader) + header->size + padding(header->size);
+
+  if (size - position < length) {
+    return Error("Truncated record at offset " + stringify(position));
+  }
+
+  Record record;
+  record.type = static_cast<Type>(header->type);
+  record.timestamp = header->timestamp;
+  record.data = data + position + sizeof(RecordHeader);
+  record.size = header->size;
+
+  position += length;
+
+  return record;
+}
+
+
+Try<Nothing> replay(
+    const Record& record,
+    MesosAllocatorProcess* process,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, Resources>&)>& offerCallback)
+{
+  Decoder decoder(record.data, record.size);
+
+  switch (record.type) {
+    case INITIALIZE: {
+      int64_t interval;
+      uint32_t count;
+      if (!decoder.decode(&interval) || !decoder.decode(&count)) {
+        break;
+      }
+
+      hashmap<string, mesos::master::RoleInfo> roles;
+      for (uint32_t i = 0; i < count; i++) {
+        string name;
+        mesos::master::RoleInfo roleInfo;
+        if (!decoder.decode(&name) || !decoder.decode(&roleInfo)) {
+          return Error("Malformed initialize record");
+        }
+        roles[name] = roleInfo;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::initialize,
+          Nanoseconds(interval),
+          offerCallback,
+          roles);
+
+      return Nothing();
+    }
+
+    case ADD_FRAMEWORK: {
+      FrameworkID frameworkId;
+      FrameworkInfo frameworkInfo;
+      hashmap<SlaveID, Resources> used;
+      if (!decoder.decode(&frameworkId) ||
+          !decoder.decode(&frameworkInfo) ||
+          !decoder.decode(&used)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::addFramework,
+          frameworkId,
+          frameworkInfo,
+          used);
+
+      return Nothing();
+    }
+
+    case REMOVE_FRAMEWORK:
+    case ACTIVATE_FRAMEWORK:
+    case DEACTIVATE_FRAMEWORK:
+    case REVIVE_OFFERS:
+    case SUPPRESS_OFFERS: {
+      FrameworkID frameworkId;
+      if (!decoder.decode(&frameworkId)) {
+        break;
+      }
+
+      void (MesosAllocatorProcess::*method)(const FrameworkID&) =
+        record.type == REMOVE_FRAMEWORK
+          ? &MesosAllocatorProcess::removeFramework
+          : record.type == ACTIVATE_FRAMEWORK
+            ? &MesosAllocatorProcess::activateFramework
+            : record.type == DEACTIVATE_FRAMEWORK
+              ? &MesosAllocatorProcess::deactivateFramework
+              : record.type == REVIVE_OFFERS
+                ? &MesosAllocatorProcess::reviveOffers
+                : &MesosAllocatorProcess::suppressOffers;
+
+      process::dispatch(process, method, frameworkId);
+
+      return Nothing();
+    }
+
+    case ADD_SLAVE: {
+      SlaveID slaveId;
+      SlaveInfo slaveInfo;
+      Resources total;
+      hashmap<FrameworkID, Resources> used;
+      if (!decoder.decode(&slaveId) ||
+          !decoder.decode(&slaveInfo) ||
+          !decoder.decode(&total) ||
+          !decoder.decode(&used)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::addSlave,
+          slaveId,
+          slaveInfo,
+          total,
+          used);
+
+      return Nothing();
+    }
+
+    case REMOVE_SLAVE:
+    case ACTIVATE_SLAVE:
+    case DEACTIVATE_SLAVE: {
+      SlaveID slaveId;
+      if (!decoder.decode(&slaveId)) {
+        break;
+      }
+
+      void (MesosAllocatorProcess::*method)(const SlaveID&) =
+        record.type == REMOVE_SLAVE
+          ? &MesosAllocatorProcess::removeSlave
+          : record.type == ACTIVATE_SLAVE
+            ? &MesosAllocatorProcess::activateSlave
+            : &MesosAllocatorProcess::deactivateSlave;
+
+      process::dispatch(process, method, slaveId);
+
+      return Nothing();
+    }
+
+    case UPDATE_WHITELIST: {
+      uint8_t present;
+      if (!decoder.decode(&present)) {
+        break;
+      }
+
+      Option<hashset<string> > whitelist = None();
+
+      if (present) {
+        uint32_t count;
+        if (!decoder.decode(&count)) {
+          break;
+        }
+
+        hashset<string> hostnames;
+        for (uint32_t i = 0; i < count; i++) {
+          string hostname;
+          if (!decoder.decode(&hostname)) {
+            return Error("Malformed whitelist record");
+          }
+          hostnames.insert(hostname);
+        }
+
+        whitelist = hostnames;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::updateWhitelist,
+          whitelist);
+
+      return Nothing();
+    }
+
+    case REQUEST_RESOURCES: {
+      FrameworkID frameworkId;
+      uint32_t count;
+      if (!decoder.decode(&frameworkId) || !decoder.decode(&count)) {
+        break;
+      }
+
+      vector<Request> requests(count);
+      for (uint32_t i = 0; i < count; i++) {
+        if (!decoder.decode(&requests[i])) {
+          return Error("Malformed request resources record");
+        }
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::requestResources,
+          frameworkId,
+          requests);
+
+      return Nothing();
+    }
+
+    case UPDATE_ALLOCATION: {
+      FrameworkID frameworkId;
+      SlaveID slaveId;
+      uint32_t count;
+      if (!decoder.decode(&frameworkId) ||
+          !decoder.decode(&slaveId) ||
+          !decoder.decode(&count)) {
+        break;
+      }
+
+      vector<Offer::Operation> operations(count);
+      for (uint32_t i = 0; i < count; i++) {
+        if (!decoder.decode(&operations[i])) {
+          return Error("Malformed update allocation record");
+        }
+      }
+
+      Option<Error> divergence = process::dispatch(
+          process,
+          &MesosAllocatorProcess::checkUpdateAllocation,
+          frameworkId,
+          slaveId,
+          operations).get();
+
+      if (divergence.isSome()) {
+        return Error("Diverged from the trace: " + divergence.get().message);
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::updateAllocation,
+          frameworkId,
+          slaveId,
+          operations);
+
+      return Nothing();
+    }
+
+    case RECOVER_RESOURCES: {
+      FrameworkID frameworkId;
+      SlaveID slaveId;
+      Resources resources;
+      uint8_t present;
+      if (!decoder.decode(&frameworkId) ||
+          !decoder.decode(&slaveId) ||
+          !decoder.decode(&resources) ||
+          !decoder.decode(&present)) {
+        break;
+      }
+
+      Option<Filters> filters = None();
+
+      if (present) {
+        Filters filters_;
+        if (!decoder.decode(&filters_)) {
+          break;
+        }
+        filters = filters_;
+      }
+
+      Option<Error> divergence = process::dispatch(
+          process,
+          &MesosAllocatorProcess::checkRecoverResources,
+          frameworkId,
+          slaveId,
+          resources).get();
+
+      if (divergence.isSome()) {
+        return Error("Diverged from the trace: " + divergence.get().message);
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::recoverResources,
+          frameworkId,
+          slaveId,
+          resources,
+          filters);
+
+      return Nothing();
+    }
+
+    case BULK_RECOVER_RESOURCES: {
+      uint32_t count;
+      if (!decoder.decode(&count)) {
+        break;
+      }
+
+      vector<RecoveredResources> recovered;
+      recovered.reserve(count);
+
+      for (uint32_t i = 0; i < count; i++) {
+        RecoveredResources recovered_;
+        uint8_t present;
+        if (!decoder.decode(&recovered_.frameworkId) ||
+            !decoder.decode(&recovered_.slaveId) ||
+            !decoder.decode(&recovered_.resources) ||
+            !decoder.decode(&present)) {
+          return Error("Malformed bulk recover resources record");
+        }
+
+        if (present) {
+          Filters filters;
+          if (!decoder.decode(&filters)) {
+            return Error("Malformed bulk recover resources record");
+          }
+          recovered_.filters = filters;
+        }
+
+        recovered.push_back(recovered_);
+      }
+
+      foreach (const RecoveredResources& recovered_, recovered) {
+        Option<Error> divergence = process::dispatch(
+            process,
+            &MesosAllocatorProcess::checkRecoverResources,
+            recovered_.frameworkId,
+            recovered_.slaveId,
+            recovered_.resources).get();
+
+        if (divergence.isSome()) {
+          return Error(
+              "Diverged from the trace: " + divergence.get().message);
+        }
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::bulkRecoverResources,
+          recovered);
+
+      return Nothing();
+    }
+
+    case ADD_ROLE: {
+      string role;
+      mesos::master::RoleInfo roleInfo;
+      if (!decoder.decode(&role) || !decoder.decode(&roleInfo)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::addRole,
+          role,
+          roleInfo);
+
+      return Nothing();
+    }
+
+    case REMOVE_ROLE: {
+      string role;
+      if (!decoder.decode(&role)) {
+        break;
+      }
+
+      process::dispatch(process, &MesosAllocatorProcess::removeRole, role);
+
+      return Nothing();
+    }
+
+    case UPDATE_WEIGHTS: {
+      uint32_t count;
+      if (!decoder.decode(&count)) {
+        break;
+      }
+
+      vector<mesos::master::RoleInfo> roleInfos(count);
+      for (uint32_t i = 0; i < count; i++) {
+        if (!decoder.decode(&roleInfos[i])) {
+          return Error("Malformed update weights record");
+        }
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::updateWeights,
+          roleInfos);
+
+      return Nothing();
+    }
+
+    case SET_QUOTA: {
+      string role;
+      Resources guarantee;
+      if (!decoder.decode(&role) || !decoder.decode(&guarantee)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::setQuota,
+          role,
+          guarantee);
+
+      return Nothing();
+    }
+
+    case REMOVE_QUOTA: {
+      string role;
+      if (!decoder.decode(&role)) {
+        break;
+      }
+
+      process::dispatch(process, &MesosAllocatorProcess::removeQuota, role);
+
+      return Nothing();
+    }
+
+    case UPDATE_SLAVE: {
+      SlaveID slaveId;
+      Resources oversubscribed;
+      if (!decoder.decode(&slaveId) || !decoder.decode(&oversubscribed)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::updateSlave,
+          slaveId,
+          oversubscribed);
+
+      return Nothing();
+    }
+
+    case UPDATE_CONSTRAINTS: {
+      FrameworkID frameworkId;
+      string constraints;
+      if (!decoder.decode(&frameworkId) || !decoder.decode(&constraints)) {
+        break;
+      }
+
+      process::dispatch(
+          process,
+          &MesosAllocatorProcess::updateConstraints,
+          frameworkId,
+          constraints);
+
+      return Nothing();
+    }
+
+    default:
+      return Error("Unknown record type " + stringify(record.type));
+  }
+
+  return Error("Malformed record of type " + stringify(record.type));
+}
+
+} // namespace trace {
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
@@ -0,0 +1,328 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_MESOS_TRACE_HPP__
+#define __MASTER_ALLOCATOR_MESOS_TRACE_HPP__
+
+#include <stdint.h>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <google/protobuf/message.h>
+
+#include <mesos/resources.hpp>
+
+#include <mesos/master/allocator.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
+#include <stout/nothing.hpp>
+#include <stout/option.hpp>
+#include <stout/result.hpp>
+#include <stout/try.hpp>
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+class MesosAllocatorProcess;
+struct RecoveredResources;
+
+// A trace is a binary log of the calls made to an allocator, which
+// can be replayed into a fresh allocator process to reproduce the
+// exact same load offline.
+//
+// The format is append-only, so it can be streamed to disk, and all
+// record headers are 8-byte aligned, so that a trace can be read in
+// place after mmap'ing it:
+//
+//   trace  := header record*
+//   header := magic[8] version:u32 seed:u32
+//   record := size:u32 type:u32 timestamp:i64 payload[size] padding
+//
+// The payload consists of native-endian integers and length-prefixed
+// serialized protobufs. Timestamps are nanoseconds of the libprocess
+// clock at the time the call was made.
+namespace trace {
+
+const char MAGIC[8] = { 'M', 'E', 'S', 'O', 'S', 'A', 'L', 'T' };
+// Bumped whenever a record type is added or changed, so that readers
+// reject newer traces at the header rather than failing halfway:
+//
+//   1: INITIALIZE to REVIVE_OFFERS.
+//   2: BULK_RECOVER_RESOURCES to UPDATE_CONSTRAINTS.
+//   3: The seed of the allocator in the header.
+const uint32_t VERSION = 3;
+
+enum Type
+{
+  INITIALIZE = 1,
+  ADD_FRAMEWORK = 2,
+  REMOVE_FRAMEWORK = 3,
+  ACTIVATE_FRAMEWORK = 4,
+  DEACTIVATE_FRAMEWORK = 5,
+  ADD_SLAVE = 6,
+  REMOVE_SLAVE = 7,
+  ACTIVATE_SLAVE = 8,
+  DEACTIVATE_SLAVE = 9,
+  UPDATE_WHITELIST = 10,
+  REQUEST_RESOURCES = 11,
+  UPDATE_ALLOCATION = 12,
+  RECOVER_RESOURCES = 13,
+  REVIVE_OFFERS = 14,
+  BULK_RECOVER_RESOURCES = 15,
+  SUPPRESS_OFFERS = 16,
+  ADD_ROLE = 17,
+  REMOVE_ROLE = 18,
+  UPDATE_WEIGHTS = 19,
+  SET_QUOTA = 20,
+  REMOVE_QUOTA = 21,
+  UPDATE_SLAVE = 22,
+  UPDATE_CONSTRAINTS = 23
+};
+
+
+struct Header
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t seed; // See '--random_seed'.
+};
+
+
+struct RecordHeader
+{
+  uint32_t size;
+  uint32_t type;
+  int64_t timestamp;
+};
+
+
+struct Record
+{
+  Type type;
+  int64_t timestamp;
+  const char* data;
+  size_t size;
+};
+
+
+// Serializes call arguments into a record payload.
+class Encoder
+{
+public:
+  void encode(uint8_t value);
+  void encode(uint32_t value);
+  void encode(int64_t value);
+  void encode(const std::string& value);
+  void encode(const google::protobuf::Message& message);
+  void encode(const Resources& resources);
+  void encode(const hashmap<SlaveID, Resources>& resources);
+  void encode(const hashmap<FrameworkID, Resources>& resources);
+
+  const std::string& data() const { return buffer; }
+
+private:
+  std::string buffer;
+};
+
+
+// Deserializes a record payload. Every method returns false if the
+// payload is exhausted or malformed.
+class Decoder
+{
+public:
+  Decoder(const char* _data, size_t _size)
+    : data(_data), size(_size), position(0) {}
+
+  bool decode(uint8_t* value);
+  bool decode(uint32_t* value);
+  bool decode(int64_t* value);
+  bool decode(std::string* value);
+  bool decode(google::protobuf::Message* message);
+  bool decode(Resources* resources);
+  bool decode(hashmap<SlaveID, Resources>* resources);
+  bool decode(hashmap<FrameworkID, Resources>* resources);
+
+  // Returns true if the whole payload has been consumed.
+  bool done() const { return position == size; }
+
+private:
+  bool read(void* destination, size_t length);
+
+  const char* data;
+  size_t size;
+  size_t position;
+};
+
+
+class Flusher;
+
+
+// Appends allocator calls to a trace file. Records are buffered and
+// written out in large chunks, and at least once per second so that
+// a crash loses little of the latest calls; writes are serialized so
+// that the writer can be shared between threads.
+class Writer
+{
+public:
+  static Try<Writer*> create(const std::string& path, uint32_t seed);
+
+  ~Writer();
+
+  void initialize(
+      const Duration& allocationInterval,
+      const hashmap<std::string, mesos::master::RoleInfo>& roles);
+
+  void addFramework(
+      const FrameworkID& frameworkId,
+      const FrameworkInfo& frameworkInfo,
+      const hashmap<SlaveID, Resources>& used);
+
+  void removeFramework(const FrameworkID& frameworkId);
+
+  void activateFramework(const FrameworkID& frameworkId);
+
+  void deactivateFramework(const FrameworkID& frameworkId);
+
+  void addSlave(
+      const SlaveID& slaveId,
+      const SlaveInfo& slaveInfo,
+      const Resources& total,
+      const hashmap<FrameworkID, Resources>& used);
+
+  void removeSlave(const SlaveID& slaveId);
+
+  void activateSlave(const SlaveID& slaveId);
+
+  void deactivateSlave(const SlaveID& slaveId);
+
+  void updateWhitelist(const Option<hashset<std::string> >& whitelist);
+
+  void requestResources(
+      const FrameworkID& frameworkId,
+      const std::vector<Request>& requests);
+
+  void updateAllocation(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const std::vector<Offer::Operation>& operations);
+
+  void recoverResources(
+      const FrameworkID& frameworkId,
+      const SlaveID& slaveId,
+      const Resources& resources,
+      const Option<Filters>& filters);
+
+  void reviveOffers(const FrameworkID& frameworkId);
+
+  void bulkRecoverResources(const std::vector<RecoveredResources>& recovered);
+
+  void suppressOffers(const FrameworkID& frameworkId);
+
+  void addRole(
+      const std::string& role,
+      const mesos::master::RoleInfo& roleInfo);
+
+  void removeRole(const std::string& role);
+
+  void updateWeights(const std::vector<mesos::master::RoleInfo>& roleInfos);
+
+  void setQuota(const std::string& role, const Resources& guarantee);
+
+  void removeQuota(const std::string& role);
+
+  void updateSlave(const SlaveID& slaveId, const Resources& oversubscribed);
+
+  void updateConstraints(
+      const FrameworkID& frameworkId,
+      const std::string& constraints);
+
+  // Writes out all buffered records.
+  void flush();
+
+private:
+  explicit Writer(int _fd) : fd(_fd), flusher(NULL) {}
+
+  void append(Type type, const Encoder& encoder);
+
+  // Must be called with 'mutex' held.
+  void _flush();
+
+  std::mutex mutex;
+  int fd;
+  std::string buffer;
+
+  // Periodically flushes the buffer, see 'FLUSH_INTERVAL'.
+  Flusher* flusher;
+};
+
+
+// Iterates over the records of a memory-mapped trace file.
+class Reader
+{
+public:
+  static Try<Reader*> create(const std::string& path);
+
+  ~Reader();
+
+  // The seed of the recorded allocator.
+  uint32_t seed() const;
+
+  // Returns the next record, none at the end of the trace, or an
+  // error if the trace is truncated or corrupted. The record points
+  // into the mapped file and stays valid as long as the reader.
+  Result<Record> next();
+
+private:
+  Reader(int _fd, const char* _data, size_t _size)
+    : fd(_fd), data(_data), size(_size), position(sizeof(Header)) {}
+
+  int fd;
+  const char* data;
+  size_t size;
+  size_t position;
+};
+
+
+// Dispatches the call stored in the record to the allocator process.
+// The offer callback is used in place of the one of the recorded
+// allocator. Returns an error rather than dispatching the call if the
+// allocator diverged from the recorded one, i.e. if the call refers to
+// resources it did not allocate. This waits for the allocator to
+// process the calls dispatched before.
+Try<Nothing> replay(
+    const Record& record,
+    MesosAllocatorProcess* process,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, Resources>&)>& offerCallback);
+
+} // namespace trace {
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_MESOS_TRACE_HPP__
@@ -43,9 +43,10 @@ bool DRFComparator::operator () (const Client& client1, const Client& client2)
 void DRFSorter::add(const string& name, double weight)
 {
   Client client(name, 0, 0);
-  clients.insert(client);
+  index[name] = clients.insert(client).first;
 
   allocations[name] = Resources();
+  allocationScalars[name] = ScalarVector();
   weights[name] = weight;
 }
 
@@ -56,9 +57,12 @@ void DRFSorter::remove(const string& name)
 
   if (it != clients.end()) {
     clients.erase(it);
+    index.erase(name);
   }
 
+  deactivated.erase(name);
   allocations.erase(name);
+  allocationScalars.erase(name);
   weights.erase(name);
 }
 
@@ -67,8 +71,16 @@ void DRFSorter::activate(const string& name)
 {
   CHECK(allocations.contains(name));
 
-  Client client(name, calculateShare(name), 0);
-  clients.insert(client);
+  // Only deactivated clients are readded, so that a client never
+  // appears twice in 'clients'.
+  if (!deactivated.contains(name)) {
+    return;
+  }
+
+  Client client(name, calculateShare(name), deactivated[name]);
+  index[name] = clients.insert(client).first;
+
+  deactivated.erase(name);
 }
 
 
@@ -77,11 +89,24 @@ void DRFSorter::deactivate(const string& name)
   set<Client, DRFComparator>::iterator it = find(name);
 
   if (it != clients.end()) {
-    // TODO(benh): Removing the client is an unfortuante strategy
-    // because we lose information such as the number of allocations
-    // for this client which means the fairness can be gamed by a
-    // framework disconnecting and reconnecting.
+    // Keep the number of allocations, so that the fairness cannot be
+    // gamed by a framework disconnecting and reconnecting.
+    deactivated[name] = it->allocations;
     clients.erase(it);
+    index.erase(name);
+  }
+}
+
+
+void DRFSorter::updateWeight(const string& name, double weight)
+{
+  CHECK(weights.contains(name));
+  weights[name] = weight;
+
+  // All shares are recalculated by the next sort if the total
+  // resources have changed.
+  if (!dirty) {
+    update(name);
   }
 }
 
@@ -90,27 +115,28 @@ void DRFSorter::allocated(
     const string& name,
     const Resources& resources)
 {
+  allocations[name] += resources;
+  allocationScalars[name] += ScalarVector(resources);
+
   set<Client, DRFComparator>::iterator it = find(name);
 
   if (it != clients.end()) { // TODO(benh): This should really be a CHECK.
-    // TODO(benh): Refactor 'update' to be able to reuse it here.
     Client client(*it);
 
     // Update the 'allocations' to reflect the allocator decision.
     client.allocations++;
 
-    // Remove and reinsert it to update the ordering appropriately.
-    clients.erase(it);
-    clients.insert(client);
-  }
-
-  allocations[name] += resources;
+    // If the total resources have changed, we're going to
+    // recalculate all the shares, so don't bother just
+    // updating this client.
+    if (!dirty) {
+      client.share = calculateShare(name);
+    }
 
-  // If the total resources have changed, we're going to
-  // recalculate all the shares, so don't bother just
-  // updating this client.
-  if (!dirty) {
-    update(name);
+    // Remove and reinsert it to update the ordering appropriately,
+    // once for both the share and the allocations.
+    clients.erase(it);
+    index[name] = clients.insert(client).first;
   }
 }
 
@@ -127,16 +153,21 @@ void DRFSorter::update(
   // Otherwise, we need to ensure we re-calculate the shares, as
   // is being currently done, for safety.
 
-  CHECK(resources.contains(oldAllocation));
+  // The client's allocation, checked below, is part of the total.
+  const ScalarVector oldScalars(oldAllocation);
+  const ScalarVector newScalars(newAllocation);
 
-  resources -= oldAllocation;
-  resources += newAllocation;
+  scalars -= oldScalars;
+  scalars += newScalars;
 
   CHECK(allocations[name].contains(oldAllocation));
 
   allocations[name] -= oldAllocation;
   allocations[name] += newAllocation;
 
+  allocationScalars[name] -= oldScalars;
+  allocationScalars[name] += newScalars;
+
   // Just assume the total has changed, per the TODO above.
   dirty = true;
 }
@@ -154,6 +185,7 @@ void DRFSorter::unallocated(
     const Resources& resources)
 {
   allocations[name] -= resources;
+  allocationScalars[name] -= ScalarVector(resources);
 
   if (!dirty) {
     update(name);
@@ -163,7 +195,7 @@ void DRFSorter::unallocated(
 
 void DRFSorter::add(const Resources& _resources)
 {
-  resources += _resources;
+  scalars += ScalarVector(_resources);
 
   // We have to recalculate all shares when the total resources
   // change, but we put it off until sort is called
@@ -175,7 +207,7 @@ void DRFSorter::add(const Resources& _resources)
 
 void DRFSorter::remove(const Resources& _resources)
 {
-  resources -= _resources;
+  scalars -= ScalarVector(_resources);
   dirty = true;
 }
 
@@ -195,7 +227,12 @@ list<string> DRFSorter::sort()
       temp.insert(client);
     }
 
-    clients = temp;
+    clients.swap(temp);
+    dirty = false;
+
+    for (it = clients.begin(); it != clients.end(); it++) {
+      index[it->name] = it;
+    }
   }
 
   list<string> result;
@@ -209,6 +246,49 @@ list<string> DRFSorter::sort()
 }
 
 
+hashmap<string, double> DRFSorter::shares()
+{
+  hashmap<string, double> result;
+  foreachkey (const string& name, allocations) {
+    result[name] = calculateShare(name);
+  }
+
+  return result;
+}
+
+
+uint64_t DRFSorter::allocationCount(const string& name)
+{
+  if (deactivated.contains(name)) {
+    return deactivated[name];
+  }
+
+  set<Client, DRFComparator>::iterator it = find(name);
+
+  return it != clients.end() ? it->allocations : 0;
+}
+
+
+void DRFSorter::setAllocationCount(const string& name, uint64_t count)
+{
+  if (deactivated.contains(name)) {
+    deactivated[name] = count;
+    return;
+  }
+
+  set<Client, DRFComparator>::iterator it = find(name);
+
+  if (it != clients.end()) {
+    Client client(*it);
+    client.allocations = count;
+
+    // Remove and reinsert it to update the ordering appropriately.
+    clients.erase(it);
+    index[name] = clients.insert(client).first;
+  }
+}
+
+
 bool DRFSorter::contains(const string& name)
 {
   return allocations.contains(name);
@@ -233,43 +313,20 @@ void DRFSorter::update(const string& name)
 
     // Remove and reinsert it to update the ordering appropriately.
     clients.erase(it);
-    clients.insert(client);
+    index[name] = clients.insert(client).first;
   }
 }
 
 
 double DRFSorter::calculateShare(const string& name)
 {
-  double share = 0;
-
   // TODO(benh): This implementation of "dominant resource fairness"
   // currently does not take into account resources that are not
   // scalars.
 
-  // Scalar resources may be spread across multiple 'Resource'
-  // objects. E.g. persistent volumes. So we first collect the names
-  // of the scalar resources, before computing the totals.
-  hashset<string> scalars;
-  foreach (const Resource& resource, resources) {
-    if (resource.type() == Value::SCALAR) {
-      scalars.insert(resource.name());
-    }
-  }
-
-  foreach (const string& scalar, scalars) {
-    Option<Value::Scalar> total = resources.get<Value::Scalar>(scalar);
-
-    if (total.isSome() && total.get().value() > 0) {
-      Option<Value::Scalar> allocation =
-        allocations[name].get<Value::Scalar>(scalar);
-
-      if (allocation.isNone()) {
-        allocation = Value::Scalar();
-      }
-
-      share = std::max(share, allocation.get().value() / total.get().value());
-    }
-  }
+  // NOTE: Scalar resources may be spread across multiple 'Resource'
+  // objects, e.g. persistent volumes, 'ScalarVector' sums them up.
+  double share = allocationScalars[name].dominantShare(scalars);
 
   return share / weights[name];
 }
@@ -277,14 +334,11 @@ double DRFSorter::calculateShare(const string& name)
 
 set<Client, DRFComparator>::iterator DRFSorter::find(const string& name)
 {
-  set<Client, DRFComparator>::iterator it;
-  for (it = clients.begin(); it != clients.end(); it++) {
-    if (name == (*it).name) {
-      break;
-    }
+  if (!index.contains(name)) {
+    return clients.end();
   }
 
-  return it;
+  return index[name];
 }
 
 } // namespace allocator {
@@ -26,6 +26,8 @@
 
 #include <stout/hashmap.hpp>
 
+#include "mesos/scalar_vector.hpp"
+
 #include "sorter/sorter.hpp"
 
 
@@ -45,8 +47,9 @@ struct Client
   // We store the number of times this client has been chosen for
   // allocation so that we can fairly share the resources across
   // clients that have the same share. Note that this information is
-  // not persisted across master failovers, but since the point is to
-  // equalize the 'allocations' across clients of the same 'share'
+  // only persisted across master failovers if the allocator is
+  // checkpointed, see '--checkpoint'. Otherwise, since the point is
+  // to equalize the 'allocations' across clients of the same 'share'
   // having allocations restart at 0 after a master failover should be
   // sufficient (famous last words.)
   uint64_t allocations;
@@ -63,6 +66,8 @@ struct DRFComparator
 class DRFSorter : public Sorter
 {
 public:
+  DRFSorter() : dirty(false) {}
+
   virtual ~DRFSorter() {}
 
   virtual void add(const std::string& name, double weight = 1);
@@ -73,6 +78,8 @@ public:
 
   virtual void deactivate(const std::string& name);
 
+  virtual void updateWeight(const std::string& name, double weight);
+
   virtual void allocated(const std::string& name,
                          const Resources& resources);
 
@@ -91,6 +98,12 @@ public:
 
   virtual std::list<std::string> sort();
 
+  virtual hashmap<std::string, double> shares();
+
+  virtual uint64_t allocationCount(const std::string& name);
+
+  virtual void setAllocationCount(const std::string& name, uint64_t count);
+
   virtual bool contains(const std::string& name);
 
   virtual int count();
@@ -104,7 +117,7 @@ private:
   double calculateShare(const std::string& name);
 
   // Returns an iterator to the specified client, if
-  // it exists in this Sorter.
+  // it exists in this Sorter, see 'index'.
   std::set<Client, DRFComparator>::iterator find(const std::string& name);
 
   // If true, start() will recalculate all shares.
@@ -113,14 +126,28 @@ private:
   // A set of Clients (names and shares) sorted by share.
   std::set<Client, DRFComparator> clients;
 
+  // Maps the names of the clients in 'clients' to their position, so
+  // that finding a client does not take a scan of all clients.
+  hashmap<std::string, std::set<Client, DRFComparator>::iterator> index;
+
+  // Maps deactivated client names to the number of times they have
+  // been chosen for allocation, which they resume from once they are
+  // activated again.
+  hashmap<std::string, uint64_t> deactivated;
+
   // Maps client names to the resources they have been allocated.
   hashmap<std::string, Resources> allocations;
 
   // Maps client names to the weights that should be applied to their shares.
   hashmap<std::string, double> weights;
 
-  // Total resources.
-  Resources resources;
+  // Scalar quantities of 'allocations', kept in sync with them so
+  // that shares are computed without 'Resources' arithmetic.
+  hashmap<std::string, ScalarVector> allocationScalars;
+
+  // Scalar quantities of the total resources, which are all the
+  // shares depend on, hence the total is not kept as 'Resources'.
+  ScalarVector scalars;
 };
 
 } // namespace allocator {
@@ -19,11 +19,15 @@
 #ifndef __MASTER_ALLOCATOR_SORTER_SORTER_HPP__
 #define __MASTER_ALLOCATOR_SORTER_SORTER_HPP__
 
+#include <stdint.h>
+
 #include <list>
 #include <string>
 
 #include <mesos/resources.hpp>
 
+#include <stout/hashmap.hpp>
+
 namespace mesos {
 namespace internal {
 namespace master {
@@ -58,8 +62,14 @@ public:
   virtual void activate(const std::string& client) = 0;
 
   // Removes a client from the sort, so it won't get allocated to.
+  // Its allocation, and how many times it has been chosen for
+  // allocation, are kept until it is activated again.
   virtual void deactivate(const std::string& client) = 0;
 
+  // Updates the weight of the client, which only moves the client
+  // within the sort rather than resorting all clients.
+  virtual void updateWeight(const std::string& client, double weight) = 0;
+
   // Specify that resources have been allocated to the given client.
   virtual void allocated(const std::string& client,
                          const Resources& resources) = 0;
@@ -90,6 +100,20 @@ public:
   // should be allocated to, according to this Sorter's policy.
   virtual std::list<std::string> sort() = 0;
 
+  // Returns the share of every client, either active or deactivated,
+  // according to this Sorter's policy.
+  virtual hashmap<std::string, double> shares() = 0;
+
+  // Returns how many times the client has been chosen for
+  // allocation, which breaks ties between clients of the same share.
+  virtual uint64_t allocationCount(const std::string& client) = 0;
+
+  // Restores how many times the client has been chosen for
+  // allocation, e.g. from a checkpoint taken before a master failover.
+  virtual void setAllocationCount(
+      const std::string& client,
+      uint64_t count) = 0;
+
   // Returns true if this Sorter contains the specified client,
   // either active or deactivated.
   virtual bool contains(const std::string& client) = 0;
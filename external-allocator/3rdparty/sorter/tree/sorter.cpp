@@ -0,0 +1,446 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include <vector>
+
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
+#include <stout/strings.hpp>
+
+#include "sorter/tree/sorter.hpp"
+
+using std::list;
+using std::string;
+using std::vector;
+
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+bool TreeSorter::NodeComparator::operator () (
+    const Node* node1,
+    const Node* node2) const
+{
+  if (node1->share == node2->share) {
+    if (node1->allocations == node2->allocations) {
+      return node1->path < node2->path;
+    }
+    return node1->allocations < node2->allocations;
+  }
+  return node1->share < node2->share;
+}
+
+
+TreeSorter::TreeSorter()
+  : dirty(false), root(new Node("", "", NULL)) {}
+
+
+TreeSorter::~TreeSorter()
+{
+  destroy(root);
+}
+
+
+void TreeSorter::add(const string& name, double weight)
+{
+  CHECK(!clients.contains(name));
+
+  const vector<string> segments = strings::tokenize(name, "/");
+  CHECK(!segments.empty()) << "Invalid client name '" << name << "'";
+
+  Node* node = root;
+  string path;
+
+  foreach (const string& segment, segments) {
+    // A client gaining descendants moves its own allocation to a
+    // virtual child, which takes over its place among the children.
+    if (node->client) {
+      Node* self = new Node(node->path, ".", node);
+      self->client = true;
+      self->weight = node->weight;
+      self->share = node->share;
+      self->allocations = node->allocations;
+      self->scalars = node->scalars;
+
+      node->client = false;
+      node->children["."] = self;
+      clients[self->path] = self;
+
+      // Neither the node nor its position among its siblings changes.
+      if (node->active) {
+        self->active = true;
+        node->sorted.insert(self);
+      }
+    }
+
+    path += (path.empty() ? "" : "/") + segment;
+
+    if (!node->children.contains(segment)) {
+      node->children[segment] = new Node(path, segment, node);
+    }
+
+    node = node->children[segment];
+  }
+
+  CHECK(!node->client)
+    << "Client '" << name << "' has the same path as '" << node->path << "'";
+
+  if (!node->children.empty()) {
+    // The client's path is the prefix of other clients.
+    Node* self = new Node(name, ".", node);
+    node->children["."] = self;
+    updateWeight(node, weight);
+    node = self;
+  }
+
+  // Name the client as given, e.g. including redundant separators.
+  // The node is not sorted yet, hence it can be renamed.
+  node->path = name;
+  node->client = true;
+  node->weight = weight;
+
+  if (!dirty) {
+    node->share = calculateShare(node);
+  }
+
+  clients[name] = node;
+
+  activate(node);
+}
+
+
+void TreeSorter::remove(const string& name)
+{
+  CHECK(clients.contains(name));
+  Node* node = clients[name];
+
+  if (node->active) {
+    deactivate(node);
+  }
+
+  // Whatever is still allocated to the client is no longer part of
+  // the allocations of its ancestors.
+  propagate(node, ScalarVector(), node->scalars, 0);
+
+  clients.erase(name);
+
+  Node* parent = node->parent;
+  parent->children.erase(node->key);
+
+  if (node->key == ".") {
+    updateWeight(parent, 1);
+  }
+
+  delete node;
+
+  // Interior nodes only exist for the clients below them, and are
+  // inactive once they have none.
+  while (parent != root && parent->children.empty()) {
+    Node* empty = parent;
+    parent = empty->parent;
+    parent->children.erase(empty->key);
+    delete empty;
+  }
+}
+
+
+void TreeSorter::activate(const string& name)
+{
+  CHECK(clients.contains(name));
+  Node* node = clients[name];
+
+  if (!node->active) {
+    activate(node);
+  }
+}
+
+
+void TreeSorter::deactivate(const string& name)
+{
+  CHECK(clients.contains(name));
+  Node* node = clients[name];
+
+  if (node->active) {
+    deactivate(node);
+  }
+}
+
+
+void TreeSorter::updateWeight(const string& name, double weight)
+{
+  CHECK(clients.contains(name));
+  Node* node = clients[name];
+
+  updateWeight(node, weight);
+
+  if (node->key == ".") {
+    updateWeight(node->parent, weight);
+  }
+}
+
+
+void TreeSorter::allocated(
+    const string& name,
+    const Resources& resources)
+{
+  CHECK(clients.contains(name));
+
+  propagate(clients[name], ScalarVector(resources), ScalarVector(), 1);
+}
+
+
+void TreeSorter::update(
+    const string& name,
+    const Resources& oldAllocation,
+    const Resources& newAllocation)
+{
+  CHECK(clients.contains(name));
+
+  propagate(
+      clients[name],
+      ScalarVector(newAllocation),
+      ScalarVector(oldAllocation),
+      0);
+}
+
+
+void TreeSorter::unallocated(
+    const string& name,
+    const Resources& resources)
+{
+  CHECK(clients.contains(name));
+
+  propagate(clients[name], ScalarVector(), ScalarVector(resources), 0);
+}
+
+
+Resources TreeSorter::allocation(const string& name)
+{
+  CHECK(clients.contains(name));
+  return clients[name]->scalars.resources();
+}
+
+
+void TreeSorter::add(const Resources& resources)
+{
+  scalars += ScalarVector(resources);
+
+  // All shares change along with the total resources, recalculate
+  // them once the clients are sorted next.
+  dirty = true;
+}
+
+
+void TreeSorter::remove(const Resources& resources)
+{
+  scalars -= ScalarVector(resources);
+  dirty = true;
+}
+
+
+list<string> TreeSorter::sort()
+{
+  if (dirty) {
+    refresh(root);
+    dirty = false;
+  }
+
+  list<string> result;
+  collect(root, &result);
+
+  return result;
+}
+
+
+hashmap<string, double> TreeSorter::shares()
+{
+  hashmap<string, double> result;
+  foreachpair (const string& name, const Node* node, clients) {
+    result[name] = calculateShare(node);
+  }
+
+  return result;
+}
+
+
+uint64_t TreeSorter::allocationCount(const string& name)
+{
+  CHECK(clients.contains(name));
+  return clients[name]->allocations;
+}
+
+
+void TreeSorter::setAllocationCount(const string& name, uint64_t count)
+{
+  CHECK(clients.contains(name));
+  Node* node = clients[name];
+
+  if (node->active) {
+    node->parent->sorted.erase(node);
+  }
+
+  node->allocations = count;
+
+  if (node->active) {
+    node->parent->sorted.insert(node);
+  }
+}
+
+
+bool TreeSorter::contains(const string& name)
+{
+  return clients.contains(name);
+}
+
+
+int TreeSorter::count()
+{
+  return clients.size();
+}
+
+
+void TreeSorter::propagate(
+    Node* node,
+    const ScalarVector& allocated,
+    const ScalarVector& unallocated,
+    uint64_t chosen)
+{
+  for (; node != root; node = node->parent) {
+    if (node->active) {
+      node->parent->sorted.erase(node);
+    }
+
+    node->scalars += allocated;
+    node->scalars -= unallocated;
+    node->allocations += chosen;
+
+    if (!dirty) {
+      node->share = calculateShare(node);
+    }
+
+    if (node->active) {
+      node->parent->sorted.insert(node);
+    }
+  }
+}
+
+
+void TreeSorter::activate(Node* node)
+{
+  node->active = true;
+
+  for (; node != root; node = node->parent) {
+    Node* parent = node->parent;
+    parent->sorted.insert(node);
+
+    if (parent == root || parent->active) {
+      break;
+    }
+
+    parent->active = true;
+  }
+}
+
+
+void TreeSorter::deactivate(Node* node)
+{
+  node->active = false;
+
+  for (; node != root; node = node->parent) {
+    Node* parent = node->parent;
+    parent->sorted.erase(node);
+
+    if (parent == root || !parent->sorted.empty()) {
+      break;
+    }
+
+    parent->active = false;
+  }
+}
+
+
+void TreeSorter::updateWeight(Node* node, double weight)
+{
+  if (node->active) {
+    node->parent->sorted.erase(node);
+  }
+
+  node->weight = weight;
+
+  if (!dirty) {
+    node->share = calculateShare(node);
+  }
+
+  if (node->active) {
+    node->parent->sorted.insert(node);
+  }
+}
+
+
+void TreeSorter::refresh(Node* node)
+{
+  node->sorted.clear();
+
+  foreachvalue (Node* child, node->children) {
+    refresh(child);
+
+    child->share = calculateShare(child);
+
+    if (child->active) {
+      node->sorted.insert(child);
+    }
+  }
+}
+
+
+void TreeSorter::collect(const Node* node, list<string>* result) const
+{
+  foreach (const Node* child, node->sorted) {
+    if (child->client) {
+      result->push_back(child->path);
+    } else {
+      collect(child, result);
+    }
+  }
+}
+
+
+void TreeSorter::destroy(Node* node)
+{
+  foreachvalue (Node* child, node->children) {
+    destroy(child);
+  }
+
+  delete node;
+}
+
+
+double TreeSorter::calculateShare(const Node* node) const
+{
+  // NOTE: Like 'DRFSorter', only scalar resources are taken into
+  // account.
+  return node->scalars.dominantShare(scalars) / node->weight;
+}
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
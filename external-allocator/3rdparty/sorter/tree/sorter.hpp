@@ -0,0 +1,212 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef __MASTER_ALLOCATOR_SORTER_TREE_SORTER_HPP__
+#define __MASTER_ALLOCATOR_SORTER_TREE_SORTER_HPP__
+
+#include <set>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <stout/hashmap.hpp>
+
+#include "mesos/scalar_vector.hpp"
+
+#include "sorter/sorter.hpp"
+
+
+namespace mesos {
+namespace internal {
+namespace master {
+namespace allocator {
+
+// Sorts clients named by '/' separated paths, e.g. roles such as
+// "org/team/service", with dominant resource fairness applied at
+// every level of the tree the paths form: siblings are ordered by
+// the dominant share of everything allocated to their subtrees, and
+// clients are sorted by visiting the subtrees in that order.
+//
+// Every node keeps the aggregate allocation of its subtree and its
+// position among its siblings up to date, so that an allocation to a
+// client only moves the nodes on its path, rather than resorting the
+// whole tree. Only a change of the total resources, e.g. a slave
+// being added, makes the next sort recalculate all shares, as with
+// 'DRFSorter'.
+//
+// A client that also has descendants, e.g. "org" along with
+// "org/team", competes with the children of its node through a
+// virtual "." child holding its own allocation. The weight of such a
+// client applies to both its node and the virtual child.
+//
+// Only the scalar quantities allocated to the clients are kept, which
+// is all their shares depend on, hence an allocation costs no
+// 'Resources' arithmetic. 'allocation' returns them as unreserved
+// resources, which suffices for sorting roles, see 'engines', but
+// not for sorting frameworks, whose allocations are read back.
+class TreeSorter : public Sorter
+{
+public:
+  TreeSorter();
+
+  virtual ~TreeSorter();
+
+  virtual void add(const std::string& name, double weight = 1);
+
+  virtual void remove(const std::string& name);
+
+  virtual void activate(const std::string& name);
+
+  virtual void deactivate(const std::string& name);
+
+  virtual void updateWeight(const std::string& name, double weight);
+
+  virtual void allocated(const std::string& name,
+                         const Resources& resources);
+
+  virtual void update(const std::string& name,
+                      const Resources& oldAllocation,
+                      const Resources& newAllocation);
+
+  virtual void unallocated(const std::string& name,
+                           const Resources& resources);
+
+  virtual Resources allocation(const std::string& name);
+
+  virtual void add(const Resources& resources);
+
+  virtual void remove(const Resources& resources);
+
+  virtual std::list<std::string> sort();
+
+  virtual hashmap<std::string, double> shares();
+
+  virtual uint64_t allocationCount(const std::string& name);
+
+  virtual void setAllocationCount(const std::string& name, uint64_t count);
+
+  virtual bool contains(const std::string& name);
+
+  virtual int count();
+
+private:
+  TreeSorter(const TreeSorter&); // Not copyable.
+  TreeSorter& operator=(const TreeSorter&); // Not assignable.
+
+  struct Node;
+
+  // Orders siblings by share, then by how many times they have been
+  // chosen for allocation, like 'DRFComparator'.
+  struct NodeComparator
+  {
+    bool operator () (const Node* node1, const Node* node2) const;
+  };
+
+  struct Node
+  {
+    Node(const std::string& _path, const std::string& _key, Node* _parent)
+      : path(_path),
+        key(_key),
+        parent(_parent),
+        client(false),
+        active(false),
+        weight(1),
+        share(0),
+        allocations(0) {}
+
+    // The client name for clients, the path prefix otherwise.
+    std::string path;
+
+    // The path segment naming this node among its siblings, "." for
+    // the virtual child of a client with descendants.
+    const std::string key;
+
+    Node* parent;
+
+    bool client;
+
+    // Whether a client is activated, or whether an interior node has
+    // activated clients below it. Only active nodes are contained in
+    // their parent's 'sorted'.
+    bool active;
+
+    double weight;
+    double share;
+
+    // Number of times the subtree has been chosen for allocation.
+    uint64_t allocations;
+
+    // Scalar quantities allocated to the subtree.
+    ScalarVector scalars;
+
+    hashmap<std::string, Node*> children;
+
+    // The active children, in the order they should be allocated to.
+    // NOTE: A child's share, weight and allocation count must not
+    // change while it is contained in here.
+    std::set<Node*, NodeComparator> sorted;
+  };
+
+  // Applies an allocation change to the client and its ancestors,
+  // moving each of them among its siblings.
+  void propagate(
+      Node* node,
+      const ScalarVector& allocated,
+      const ScalarVector& unallocated,
+      uint64_t chosen);
+
+  // Adds the node to its parent's sort, activating ancestors without
+  // other active children.
+  void activate(Node* node);
+
+  // Removes the node from its parent's sort, deactivating ancestors
+  // left without active children.
+  void deactivate(Node* node);
+
+  void updateWeight(Node* node, double weight);
+
+  // Recalculates the shares of the node's subtree and sorts it again.
+  void refresh(Node* node);
+
+  // Appends the clients of the node's subtree in sort order.
+  void collect(const Node* node, std::list<std::string>* result) const;
+
+  // Deletes the node's subtree.
+  void destroy(Node* node);
+
+  // Returns the dominant resource share of the node's subtree.
+  double calculateShare(const Node* node) const;
+
+  // If true, sort() will recalculate all shares.
+  bool dirty;
+
+  Node* root;
+
+  // Maps client names to their nodes.
+  hashmap<std::string, Node*> clients;
+
+  // Scalar quantities of the total resources.
+  ScalarVector scalars;
+};
+
+} // namespace allocator {
+} // namespace master {
+} // namespace internal {
+} // namespace mesos {
+
+#endif // __MASTER_ALLOCATOR_SORTER_TREE_SORTER_HPP__
@@ -16,27 +16,61 @@
  * limitations under the License.
  */
 
+#include <map>
+#include <string>
+
 #include <mesos/master/allocator.hpp>
 #include <mesos/module/allocator.hpp>
 
+#include <glog/logging.h>
+
+#include <stout/foreach.hpp>
 #include <stout/try.hpp>
 
 #include "3rdparty/constants.hpp"
+#include "3rdparty/mesos/engines.hpp"
+#include "3rdparty/mesos/flags.hpp"
 #include "3rdparty/mesos/hierarchical.hpp"
 
 using namespace mesos;
 
 using mesos::master::allocator::Allocator;
-using mesos::internal::master::allocator::HierarchicalDRFAllocator;
+using mesos::internal::master::allocator::Flags;
+using mesos::internal::master::allocator::HierarchicalAllocatorProcess;
+
+namespace engines = mesos::internal::master::allocator::engines;
+
+using std::string;
 
 
 static Allocator* createDRFAllocator(const Parameters& parameters)
 {
-  Try<Allocator*> allocator = HierarchicalDRFAllocator::create();
+  std::map<string, string> values;
+  foreach (const mesos::Parameter& parameter, parameters.parameter()) {
+    if (parameter.has_key() && parameter.has_value()) {
+      values[parameter.key()] = parameter.value();
+    }
+  }
+
+  Flags flags;
+
+  Try<Nothing> load = flags.load(values);
+  if (load.isError()) {
+    LOG(ERROR) << "Failed to load allocator parameters: " << load.error();
+    return NULL;
+  }
+
+  Try<Allocator*> allocator =
+    engines::create<engines::AllocatorCreator<HierarchicalAllocatorProcess> >(
+        flags);
+
   if (allocator.isError()) {
+    LOG(ERROR) << "Failed to create allocator: " << allocator.error();
     return NULL;
   }
 
+  LOG(INFO) << "Created allocator engine '" << engines::name(flags) << "'";
+
   return allocator.get();
 }
 
@@ -0,0 +1,385 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tests of the allocator's building blocks that do not need a master,
+// run by 'ctest'. A failed check aborts with the check that failed.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <list>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <mesos/resources.hpp>
+#include <mesos/type_utils.hpp>
+
+#include <stout/check.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/os.hpp>
+#include <stout/path.hpp>
+#include <stout/stringify.hpp>
+
+#include "mesos/checkpoint.hpp"
+#include "mesos/range_resources.hpp"
+#include "mesos/trace.hpp"
+#include "sorter/drf/sorter.hpp"
+#include "sorter/tree/sorter.hpp"
+
+using namespace mesos;
+using namespace mesos::internal::master::allocator;
+
+using std::cout;
+using std::endl;
+using std::list;
+using std::string;
+using std::vector;
+
+
+static Resources parse(const string& text)
+{
+  Try<Resources> resources = Resources::parse(text);
+  CHECK_SOME(resources);
+  return resources.get();
+}
+
+
+// Every other port from 31000 on, as left behind by many partial
+// offers.
+static Resources fragmented(int fragments, const string& role)
+{
+  Resource ports;
+  ports.set_name("ports");
+  ports.set_type(Value::RANGES);
+  ports.set_role(role);
+
+  for (int i = 0; i < fragments; i++) {
+    Value::Range* range = ports.mutable_ranges()->add_range();
+    range->set_begin(31000 + 2 * i);
+    range->set_end(31000 + 2 * i);
+  }
+
+  return ports;
+}
+
+
+// Without nesting, the tree of roles is flat, which the tree sorter
+// must order exactly like the DRF sorter, through allocations,
+// deactivations, weight changes and changes of the total.
+static void testTreeSorterMatchesDRFSorterOnFlatRoles()
+{
+  DRFSorter drf;
+  TreeSorter tree;
+
+  const Resources total = parse("cpus:100;mem:102400;disk:1048576");
+  drf.add(total);
+  tree.add(total);
+
+  vector<string> roles;
+  hashset<string> active;
+  hashmap<string, Resources> allocations;
+
+  for (int i = 0; i < 20; i++) {
+    const string role = "role" + stringify(i);
+    drf.add(role, 1 + i % 3);
+    tree.add(role, 1 + i % 3);
+    roles.push_back(role);
+    active.insert(role);
+  }
+
+  const Resources task = parse("cpus:1;mem:512");
+  const Resources small = parse("cpus:0.5;mem:2048");
+
+  std::mt19937 random(42);
+
+  for (int step = 0; step < 2000; step++) {
+    const string role = roles[random() % roles.size()];
+
+    switch (random() % 6) {
+      case 0:
+      case 1: {
+        // Like the allocator, only allocate to active roles.
+        if (active.contains(role)) {
+          const Resources resources = random() % 2 == 0 ? task : small;
+          drf.allocated(role, resources);
+          tree.allocated(role, resources);
+          allocations[role] += resources;
+        }
+        break;
+      }
+      case 2: {
+        if (allocations[role].contains(task)) {
+          drf.unallocated(role, task);
+          tree.unallocated(role, task);
+          allocations[role] -= task;
+        }
+        break;
+      }
+      case 3: {
+        if (active.contains(role)) {
+          drf.deactivate(role);
+          tree.deactivate(role);
+          active.erase(role);
+        } else {
+          drf.activate(role);
+          tree.activate(role);
+          active.insert(role);
+        }
+        break;
+      }
+      case 4: {
+        const double weight = 1 + random() % 4;
+        drf.updateWeight(role, weight);
+        tree.updateWeight(role, weight);
+        break;
+      }
+      case 5: {
+        drf.add(task);
+        tree.add(task);
+        break;
+      }
+    }
+
+    const list<string> expected = drf.sort();
+    const list<string> actual = tree.sort();
+
+    CHECK(expected == actual)
+      << "Step " << step << ": expected " << stringify(expected)
+      << " but got " << stringify(actual);
+
+    const hashmap<string, double> shares = tree.shares();
+    foreachpair (const string& name, double share, drf.shares()) {
+      CHECK_EQ(share, shares.get(name).get()) << "Step " << step;
+    }
+  }
+}
+
+
+static void testTraceRoundTrip(const string& directory)
+{
+  const string path = path::join(directory, "trace");
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+
+  FrameworkInfo frameworkInfo;
+  frameworkInfo.mutable_id()->CopyFrom(frameworkId);
+  frameworkInfo.set_user("user");
+  frameworkInfo.set_name("name");
+  frameworkInfo.set_role("role");
+
+  SlaveID slaveId;
+  slaveId.set_value("slave");
+
+  hashmap<SlaveID, Resources> used;
+  used[slaveId] = parse("cpus:1;mem:512;ports:[31000-31005]");
+
+  const Resources guarantee = parse("cpus:4;mem:4096");
+
+  Try<trace::Writer*> writer = trace::Writer::create(path, 1234);
+  CHECK_SOME(writer);
+
+  writer.get()->addFramework(frameworkId, frameworkInfo, used);
+  writer.get()->setQuota("role", guarantee);
+  writer.get()->removeSlave(slaveId);
+  delete writer.get();
+
+  Try<trace::Reader*> reader = trace::Reader::create(path);
+  CHECK_SOME(reader);
+  CHECK_EQ(1234u, reader.get()->seed());
+
+  Result<trace::Record> record = reader.get()->next();
+  CHECK_SOME(record);
+  CHECK_EQ(trace::ADD_FRAMEWORK, record.get().type);
+
+  {
+    trace::Decoder decoder(record.get().data, record.get().size);
+
+    FrameworkID frameworkId_;
+    FrameworkInfo frameworkInfo_;
+    hashmap<SlaveID, Resources> used_;
+
+    CHECK(decoder.decode(&frameworkId_));
+    CHECK(decoder.decode(&frameworkInfo_));
+    CHECK(decoder.decode(&used_));
+    CHECK(decoder.done());
+
+    CHECK_EQ(frameworkId, frameworkId_);
+    CHECK_EQ(frameworkInfo.SerializeAsString(),
+             frameworkInfo_.SerializeAsString());
+    CHECK(used == used_);
+  }
+
+  record = reader.get()->next();
+  CHECK_SOME(record);
+  CHECK_EQ(trace::SET_QUOTA, record.get().type);
+
+  {
+    trace::Decoder decoder(record.get().data, record.get().size);
+
+    string role;
+    Resources guarantee_;
+
+    CHECK(decoder.decode(&role));
+    CHECK(decoder.decode(&guarantee_));
+    CHECK(decoder.done());
+
+    CHECK_EQ("role", role);
+    CHECK_EQ(guarantee, guarantee_);
+  }
+
+  record = reader.get()->next();
+  CHECK_SOME(record);
+  CHECK_EQ(trace::REMOVE_SLAVE, record.get().type);
+
+  {
+    trace::Decoder decoder(record.get().data, record.get().size);
+
+    SlaveID slaveId_;
+    CHECK(decoder.decode(&slaveId_));
+    CHECK(decoder.done());
+
+    CHECK_EQ(slaveId, slaveId_);
+  }
+
+  CHECK(reader.get()->next().isNone());
+
+  delete reader.get();
+}
+
+
+static void testCheckpointRoundTrip(const string& directory)
+{
+  const string path = path::join(directory, "checkpoint");
+
+  CHECK(checkpoint::read(path).isNone());
+
+  FrameworkID frameworkId;
+  frameworkId.set_value("framework");
+
+  SlaveID slaveId;
+  slaveId.set_value("slave");
+
+  checkpoint::State state;
+  state.time = 42;
+  state.roles["role"] = 7;
+  state.frameworks[frameworkId].role = "role";
+  state.frameworks[frameworkId].allocations = 3;
+  state.slaves[slaveId].hostname = "host";
+  state.slaves[slaveId].total = parse("cpus:16;mem:65536;ports:[31000-32000]");
+
+  CHECK_SOME(checkpoint::write(path, state));
+
+  Result<checkpoint::State> read = checkpoint::read(path);
+  CHECK_SOME(read);
+
+  CHECK_EQ(state.time, read.get().time);
+  CHECK(state.roles == read.get().roles);
+
+  CHECK_EQ(1u, read.get().frameworks.size());
+  CHECK_EQ("role", read.get().frameworks[frameworkId].role);
+  CHECK_EQ(3u, read.get().frameworks[frameworkId].allocations);
+
+  CHECK_EQ(1u, read.get().slaves.size());
+  CHECK_EQ("host", read.get().slaves[slaveId].hostname);
+  CHECK_EQ(state.slaves[slaveId].total, read.get().slaves[slaveId].total);
+
+  // A checkpoint cut short is rejected rather than partially loaded.
+  Try<string> contents = os::read(path);
+  CHECK_SOME(contents);
+  const string& data = contents.get();
+  CHECK_SOME(os::write(path, data.substr(0, data.size() / 2)));
+
+  CHECK(checkpoint::read(path).isError());
+}
+
+
+static void testRangeResourcesOnFragmentedRanges()
+{
+  const int FRAGMENTS = 1000;
+
+  const Resources ports = fragmented(FRAGMENTS, "*");
+  const RangeResources ranges(ports);
+
+  CHECK_EQ(ports, ranges.resources());
+
+  // A port in the middle of the fragments, and one in a gap.
+  const Resources port = parse("ports:[32000-32000]");
+  const Resources gap = parse("ports:[32001-32001]");
+
+  CHECK(ranges.contains(RangeResources(port)));
+  CHECK(!ranges.contains(RangeResources(gap)));
+  CHECK(!ranges.contains(RangeResources(port + gap)));
+
+  RangeResources available = ranges;
+  available -= RangeResources(port);
+
+  CHECK(!available.contains(RangeResources(port)));
+  CHECK_EQ(ports - port, available.resources());
+
+  available += RangeResources(port);
+  CHECK(available == ranges);
+
+  // Filling all gaps merges the fragments into a single range.
+  available += RangeResources(parse("ports:[31001-32997]"));
+
+  CHECK_EQ(parse("ports:[31000-32998]"), available.resources());
+
+  // Ranges of different roles are kept apart.
+  const Resources reserved = fragmented(FRAGMENTS, "role");
+  available = ranges;
+  available += RangeResources(reserved);
+
+  CHECK_EQ(ports + reserved, available.resources("role"));
+  CHECK_EQ(ports, available.resources("other"));
+
+  available -= RangeResources(reserved);
+  CHECK(available == ranges);
+
+  // Non-range resources are ignored.
+  CHECK(RangeResources(parse("cpus:1;mem:512")).empty());
+}
+
+
+int main()
+{
+  Try<string> directory = os::mkdtemp();
+  CHECK_SOME(directory);
+
+  cout << "TreeSorterMatchesDRFSorterOnFlatRoles" << endl;
+  testTreeSorterMatchesDRFSorterOnFlatRoles();
+
+  cout << "TraceRoundTrip" << endl;
+  testTraceRoundTrip(directory.get());
+
+  cout << "CheckpointRoundTrip" << endl;
+  testCheckpointRoundTrip(directory.get());
+
+  cout << "RangeResourcesOnFragmentedRanges" << endl;
+  testRangeResourcesOnFragmentedRanges();
+
+  CHECK_SOME(os::rmdir(directory.get()));
+
+  cout << "All tests passed" << endl;
+
+  return EXIT_SUCCESS;
+}
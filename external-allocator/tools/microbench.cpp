@@ -0,0 +1,464 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Micro-benchmarks of the arithmetic the allocator performs for
+// every grant, comparing 'Resources' with the allocator's internal
+// representations.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <mesos/resources.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/flags.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashset.hpp>
+#include <stout/none.hpp>
+#include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+
+#include "mesos/range_resources.hpp"
+#include "mesos/scalar_vector.hpp"
+#include "sorter/drf/sorter.hpp"
+#include "sorter/tree/sorter.hpp"
+
+using namespace mesos;
+using namespace mesos::internal::master::allocator;
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+class MicrobenchFlags : public virtual flags::FlagsBase
+{
+public:
+  MicrobenchFlags()
+  {
+    add(&MicrobenchFlags::iterations,
+        "iterations",
+        "Number of iterations of every arithmetic benchmark.",
+        1000000);
+
+    add(&MicrobenchFlags::sorter_iterations,
+        "sorter_iterations",
+        "Number of grants of the sorter benchmark.",
+        10000);
+
+    add(&MicrobenchFlags::clients,
+        "clients",
+        "Number of clients of the sorter benchmarks.",
+        1000);
+
+    add(&MicrobenchFlags::fanout,
+        "fanout",
+        "Number of children of every interior role of the role sorter\n"
+        "benchmarks, whose clients are nested three levels deep, e.g.\n"
+        "'org0/team1/service2'.",
+        10);
+
+    add(&MicrobenchFlags::fragments,
+        "fragments",
+        "Number of disjoint port ranges of the fragmented ports\n"
+        "benchmarks.",
+        1000);
+
+    add(&MicrobenchFlags::slave,
+        "slave",
+        "Resources of a slave.",
+        "cpus:16;mem:65536;disk:1048576;ports:[31000-32000]");
+
+    add(&MicrobenchFlags::task,
+        "task",
+        "Resources of a task.",
+        "cpus:1;mem:1024;disk:1024");
+  }
+
+  int iterations;
+  int sorter_iterations;
+  int clients;
+  int fanout;
+  int fragments;
+  string slave;
+  string task;
+};
+
+
+// Keeps the compiler from optimizing the benchmarked code away.
+static volatile double sink = 0;
+
+
+static void report(const string& name, int operations, const Duration& elapsed)
+{
+  cout << std::left << std::setw(28) << name << std::right
+       << std::setw(12) << std::fixed << std::setprecision(1)
+       << elapsed.ns() / static_cast<double>(operations) << " ns/op" << endl;
+}
+
+
+// The dominant share as computed on 'Resources', for reference.
+static double share(const Resources& allocation, const Resources& total)
+{
+  double share = 0;
+
+  hashset<string> scalars;
+  foreach (const Resource& resource, total) {
+    if (resource.type() == Value::SCALAR) {
+      scalars.insert(resource.name());
+    }
+  }
+
+  foreach (const string& scalar, scalars) {
+    Option<Value::Scalar> total_ = total.get<Value::Scalar>(scalar);
+
+    if (total_.isSome() && total_.get().value() > 0) {
+      Option<Value::Scalar> allocation_ =
+        allocation.get<Value::Scalar>(scalar);
+
+      if (allocation_.isSome()) {
+        share = std::max(
+            share, allocation_.get().value() / total_.get().value());
+      }
+    }
+  }
+
+  return share;
+}
+
+
+static void benchmarkResources(
+    const MicrobenchFlags& flags,
+    const Resources& slave,
+    const Resources& task)
+{
+  Stopwatch stopwatch;
+
+  Resources available = slave;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    available -= task;
+    available += task;
+  }
+  report("resources add/subtract", flags.iterations, stopwatch.elapsed());
+  sink = sink + available.size();
+
+  bool contained = true;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    contained = contained && slave.contains(task);
+  }
+  report("resources contains", flags.iterations, stopwatch.elapsed());
+  sink = sink + contained;
+
+  double total = 0;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    total += share(task, slave);
+  }
+  report("resources dominant share", flags.iterations, stopwatch.elapsed());
+  sink = sink + total;
+}
+
+
+static void benchmarkScalars(
+    const MicrobenchFlags& flags,
+    const Resources& slave_,
+    const Resources& task_)
+{
+  const ScalarVector slave(slave_);
+  const ScalarVector task(task_);
+
+  Stopwatch stopwatch;
+
+  ScalarVector available = slave;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    available -= task;
+    available += task;
+  }
+  report("scalars add/subtract", flags.iterations, stopwatch.elapsed());
+  sink = sink + available.get(ScalarVector::CPUS);
+
+  bool contained = true;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    contained = contained && slave.contains(task);
+  }
+  report("scalars contains", flags.iterations, stopwatch.elapsed());
+  sink = sink + contained;
+
+  double total = 0;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    total += task.dominantShare(slave);
+  }
+  report("scalars dominant share", flags.iterations, stopwatch.elapsed());
+  sink = sink + total;
+}
+
+
+// A grant as done by the allocator: the granted resources are added
+// to the sorter and allocated to the first client, then the clients
+// are sorted again for the next grant.
+static void benchmarkSorter(
+    const MicrobenchFlags& flags,
+    const Resources& slave,
+    const Resources& task)
+{
+  DRFSorter sorter;
+
+  for (int i = 0; i < flags.clients; i++) {
+    sorter.add("client-" + stringify(i));
+  }
+
+  sorter.add(slave);
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  for (int i = 0; i < flags.sorter_iterations; i++) {
+    const string client = sorter.sort().front();
+    sorter.add(task);
+    sorter.allocated(client, task);
+  }
+
+  report("sorter grant", flags.sorter_iterations, stopwatch.elapsed());
+}
+
+
+// The bookkeeping of a grant in the sorters, i.e., the framework
+// sorter's total and the allocations of the framework and its role,
+// as the sorters used to keep it, as both 'Resources' and scalars,
+// and as they keep it now, where only the framework's allocation is
+// kept as 'Resources', since it is read back by the allocator.
+static void benchmarkGrant(
+    const MicrobenchFlags& flags,
+    const Resources& task)
+{
+  Stopwatch stopwatch;
+
+  Resources total;
+  Resources allocation;
+  Resources roleAllocation;
+  ScalarVector totalScalars;
+  ScalarVector allocationScalars;
+  ScalarVector roleScalars;
+
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    total += task;
+    totalScalars += ScalarVector(task);
+    allocation += task;
+    allocationScalars += ScalarVector(task);
+    roleAllocation += task.unreserved();
+    roleScalars += ScalarVector(task.unreserved());
+  }
+  report("grant bookkeeping before", flags.iterations, stopwatch.elapsed());
+  sink = sink + total.size() + roleAllocation.size();
+
+  allocation = Resources();
+
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    const ScalarVector scalars(task);
+    totalScalars += scalars;
+    allocation += task;
+    allocationScalars += scalars;
+    roleScalars += ScalarVector(task.unreserved());
+  }
+  report("grant bookkeeping after", flags.iterations, stopwatch.elapsed());
+  sink = sink + allocation.size() + roleScalars.get(ScalarVector::CPUS);
+}
+
+
+// Returns the name of a client nested three levels deep.
+static string nested(int i, int fanout)
+{
+  return "org" + stringify(i / (fanout * fanout)) +
+         "/team" + stringify(i / fanout % fanout) +
+         "/service" + stringify(i % fanout);
+}
+
+
+// Grants as seen by the role sorter, whose total resources only
+// change along with the slaves, timing sorting the clients and
+// allocating to them separately.
+static void benchmarkRoleSorter(
+    const MicrobenchFlags& flags,
+    const string& name,
+    Sorter* sorter,
+    const Resources& slave,
+    const Resources& task)
+{
+  for (int i = 0; i < flags.clients; i++) {
+    sorter->add(nested(i, flags.fanout));
+  }
+
+  sorter->add(slave);
+
+  size_t sorted = 0;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+  for (int i = 0; i < flags.sorter_iterations; i++) {
+    sorted += sorter->sort().size();
+  }
+  report(name + " role sort", flags.sorter_iterations, stopwatch.elapsed());
+  sink = sink + sorted;
+
+  stopwatch.start();
+  for (int i = 0; i < flags.sorter_iterations; i++) {
+    sorter->allocated(nested(i % flags.clients, flags.fanout), task);
+  }
+  report(
+      name + " role allocated",
+      flags.sorter_iterations,
+      stopwatch.elapsed());
+}
+
+
+// Ports fragmented into every other port, as left behind by many
+// partial offers, and a single port out of the middle of them.
+static void benchmarkPorts(const MicrobenchFlags& flags)
+{
+  Resource ports;
+  ports.set_name("ports");
+  ports.set_type(Value::RANGES);
+  ports.set_role("*");
+
+  for (int i = 0; i < flags.fragments; i++) {
+    Value::Range* range = ports.mutable_ranges()->add_range();
+    range->set_begin(31000 + 2 * i);
+    range->set_end(31000 + 2 * i);
+  }
+
+  Resource port = ports;
+  port.clear_ranges();
+
+  Value::Range* range = port.mutable_ranges()->add_range();
+  range->set_begin(31000 + 2 * (flags.fragments / 2));
+  range->set_end(31000 + 2 * (flags.fragments / 2));
+
+  const Resources fragmented = ports;
+  const Resources single = port;
+
+  Stopwatch stopwatch;
+
+  Resources available = fragmented;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    available -= single;
+    available += single;
+  }
+  report("resources ports add/sub", flags.iterations, stopwatch.elapsed());
+  sink = sink + available.size();
+
+  bool contained = true;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    contained = contained && fragmented.contains(single);
+  }
+  report("resources ports contains", flags.iterations, stopwatch.elapsed());
+  sink = sink + contained;
+
+  const RangeResources fragmented_(fragmented);
+  const RangeResources single_(single);
+
+  RangeResources available_ = fragmented_;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    available_ -= single_;
+    available_ += single_;
+  }
+  report("ranges ports add/sub", flags.iterations, stopwatch.elapsed());
+  sink = sink + available_.empty();
+
+  contained = true;
+  stopwatch.start();
+  for (int i = 0; i < flags.iterations; i++) {
+    contained = contained && fragmented_.contains(single_);
+  }
+  report("ranges ports contains", flags.iterations, stopwatch.elapsed());
+  sink = sink + contained;
+}
+
+
+static void usage(const char* argv0, const flags::FlagsBase& flags)
+{
+  cerr << "Usage: " << os::basename(argv0).get() << " [...]" << endl
+       << endl
+       << "Supported options:" << endl
+       << flags.usage();
+}
+
+
+int main(int argc, char** argv)
+{
+  MicrobenchFlags flags;
+
+  Try<Nothing> load = flags.load(None(), argc, argv);
+  if (load.isError()) {
+    cerr << load.error() << endl;
+    usage(argv[0], flags);
+    return EXIT_FAILURE;
+  }
+
+  if (flags.iterations <= 0 ||
+      flags.sorter_iterations <= 0 ||
+      flags.clients <= 0 ||
+      flags.fanout <= 0 ||
+      flags.fragments <= 0) {
+    cerr << "--iterations, --sorter_iterations, --clients, --fanout and "
+         << "--fragments must be positive" << endl;
+    return EXIT_FAILURE;
+  }
+
+  Try<Resources> slave = Resources::parse(flags.slave);
+  if (slave.isError()) {
+    cerr << "Failed to parse --slave: " << slave.error() << endl;
+    return EXIT_FAILURE;
+  }
+
+  Try<Resources> task = Resources::parse(flags.task);
+  if (task.isError()) {
+    cerr << "Failed to parse --task: " << task.error() << endl;
+    return EXIT_FAILURE;
+  }
+
+  benchmarkResources(flags, slave.get(), task.get());
+  benchmarkScalars(flags, slave.get(), task.get());
+  benchmarkSorter(flags, slave.get(), task.get());
+  benchmarkGrant(flags, task.get());
+
+  DRFSorter drf;
+  benchmarkRoleSorter(flags, "drf", &drf, slave.get(), task.get());
+
+  TreeSorter tree;
+  benchmarkRoleSorter(flags, "tree", &tree, slave.get(), task.get());
+  benchmarkPorts(flags);
+
+  return EXIT_SUCCESS;
+}
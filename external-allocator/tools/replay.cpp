@@ -0,0 +1,229 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Replays an allocator trace, see 'trace.hpp', into a fresh
+// 'HierarchicalAllocatorProcess' of the engine selected by the
+// allocator flags, see 'engines.hpp', as fast as possible.
+//
+// The libprocess clock is paused and advanced to the timestamp of
+// every record before it is dispatched, so that refuse filters
+// expire and batch allocations happen at the recorded points of the
+// trace, independently of how fast the replay runs.
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <iomanip>
+#include <iostream>
+#include <string>
+
+#include <process/clock.hpp>
+#include <process/id.hpp>
+#include <process/process.hpp>
+#include <process/time.hpp>
+
+#include <stout/duration.hpp>
+#include <stout/flags.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/none.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+
+#include "mesos/engines.hpp"
+#include "mesos/hierarchical.hpp"
+#include "mesos/trace.hpp"
+
+using namespace mesos;
+using namespace mesos::internal::master::allocator;
+
+using process::Clock;
+using process::Time;
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::string;
+
+
+// The allocator flags are accepted as well, so that different
+// allocator configurations can be compared on the same trace.
+class ReplayFlags : public virtual Flags
+{
+public:
+  ReplayFlags()
+  {
+    add(&ReplayFlags::input,
+        "input",
+        "Path to the allocator trace to replay.");
+  }
+
+  Option<string> input;
+};
+
+
+// Counts offers made by the allocator. The callback is invoked on
+// the allocator's thread only.
+struct OfferCounter
+{
+  OfferCounter() : offers(0) {}
+
+  void offer(
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources)
+  {
+    offers += resources.size();
+  }
+
+  uint64_t offers;
+};
+
+
+static void usage(const char* argv0, const flags::FlagsBase& flags)
+{
+  cerr << "Usage: " << os::basename(argv0).get() << " --input=PATH" << endl
+       << endl
+       << "Supported options:" << endl
+       << flags.usage();
+}
+
+
+int main(int argc, char** argv)
+{
+  ReplayFlags flags;
+
+  Try<Nothing> load = flags.load(None(), argc, argv);
+  if (load.isError()) {
+    cerr << load.error() << endl;
+    usage(argv[0], flags);
+    return EXIT_FAILURE;
+  }
+
+  if (flags.input.isNone()) {
+    cerr << "Missing required option --input" << endl;
+    usage(argv[0], flags);
+    return EXIT_FAILURE;
+  }
+
+  Try<trace::Reader*> reader = trace::Reader::create(flags.input.get());
+  if (reader.isError()) {
+    cerr << reader.error() << endl;
+    return EXIT_FAILURE;
+  }
+
+  // Allocate from slaves in the recorded order, unless another seed
+  // is given to compare with.
+  if (flags.random_seed.isNone()) {
+    flags.random_seed = reader.get()->seed();
+  }
+
+  Clock::pause();
+
+  Try<MesosAllocatorProcess*> allocator =
+    engines::create<engines::ProcessCreator<HierarchicalAllocatorProcess> >(
+        flags);
+
+  if (allocator.isError()) {
+    cerr << allocator.error() << endl;
+    usage(argv[0], flags);
+    delete reader.get();
+    return EXIT_FAILURE;
+  }
+
+  MesosAllocatorProcess* process = allocator.get();
+  process::spawn(process);
+
+  cout << "Replaying into allocator engine '" << engines::name(flags)
+       << "' with seed " << flags.random_seed.get() << endl;
+
+  OfferCounter counter;
+
+  lambda::function<
+      void(const FrameworkID&,
+           const hashmap<SlaveID, Resources>&)> offerCallback =
+    lambda::bind(&OfferCounter::offer, &counter, lambda::_1, lambda::_2);
+
+  // The clock time the first record is mapped to.
+  const Time start = Clock::now();
+  Option<int64_t> origin = None();
+
+  uint64_t records = 0;
+  int status = EXIT_SUCCESS;
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  while (true) {
+    Result<trace::Record> record = reader.get()->next();
+
+    if (record.isNone()) {
+      break;
+    }
+
+    if (record.isError()) {
+      cerr << "Stopping replay: " << record.error() << endl;
+      status = EXIT_FAILURE;
+      break;
+    }
+
+    if (origin.isNone()) {
+      origin = record.get().timestamp;
+    }
+
+    Time target = start + Nanoseconds(record.get().timestamp - origin.get());
+    if (target > Clock::now()) {
+      Clock::advance(target - Clock::now());
+      Clock::settle();
+    }
+
+    Try<Nothing> replay =
+      trace::replay(record.get(), process, offerCallback);
+
+    if (replay.isError()) {
+      cerr << "Stopping replay: " << replay.error() << endl;
+      status = EXIT_FAILURE;
+      break;
+    }
+
+    records++;
+  }
+
+  // Wait for the allocator to process all dispatched calls.
+  Clock::settle();
+
+  Duration elapsed = stopwatch.elapsed();
+
+  cout << "Replayed " << records << " records in " << elapsed << endl
+       << "  simulated:  " << (Clock::now() - start) << endl
+       << "  offers:     " << counter.offers << endl;
+
+  if (elapsed > Duration::zero()) {
+    cout << "  records/s:  " << std::fixed << std::setprecision(0)
+         << records / elapsed.secs() << endl;
+  }
+
+  process::terminate(process);
+  process::wait(process);
+  delete process;
+
+  delete reader.get();
+
+  Clock::resume();
+
+  return status;
+}
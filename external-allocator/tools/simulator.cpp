@@ -0,0 +1,1349 @@
+/**
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements.  See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership.  The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License.  You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Drives 'HierarchicalAllocatorProcess' with a synthetic cluster and
+// a stub offer callback, so that allocator changes can be measured on
+// a developer box without running a Mesos master.
+//
+// Time is simulated: the libprocess clock is paused and advanced by
+// '--cycle_interval' between allocation cycles, so that refuse
+// filters expire deterministically regardless of how long the
+// allocator actually takes.
+
+#include <errno.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <mesos/resources.hpp>
+
+#include <process/clock.hpp>
+#include <process/dispatch.hpp>
+#include <process/future.hpp>
+#include <process/id.hpp>
+#include <process/pid.hpp>
+#include <process/process.hpp>
+
+#include <stout/bytes.hpp>
+#include <stout/duration.hpp>
+#include <stout/flags.hpp>
+#include <stout/foreach.hpp>
+#include <stout/hashmap.hpp>
+#include <stout/hashset.hpp>
+#include <stout/lambda.hpp>
+#include <stout/none.hpp>
+#include <stout/numify.hpp>
+#include <stout/option.hpp>
+#include <stout/os.hpp>
+#include <stout/stopwatch.hpp>
+#include <stout/stringify.hpp>
+#include <stout/strings.hpp>
+
+#include "mesos/engines.hpp"
+#include "mesos/hierarchical.hpp"
+#include "mesos/state.hpp"
+
+using namespace mesos;
+using namespace mesos::internal::master::allocator;
+
+using process::Clock;
+using process::PID;
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::list;
+using std::string;
+using std::vector;
+
+
+// The allocator flags are accepted as well, so that different
+// allocator configurations can be compared.
+class SimulatorFlags : public virtual Flags
+{
+public:
+  SimulatorFlags()
+  {
+    add(&SimulatorFlags::slaves,
+        "slaves",
+        "Number of slaves in the synthetic cluster.",
+        1000);
+
+    add(&SimulatorFlags::frameworks,
+        "frameworks",
+        "Number of frameworks, spread round-robin across roles.",
+        100);
+
+    add(&SimulatorFlags::roles,
+        "roles",
+        "Number of roles, all with weight 1.",
+        10);
+
+    add(&SimulatorFlags::slave_shapes,
+        "slave_shapes",
+        "'|' separated list of slave resource shapes, assigned\n"
+        "round-robin to slaves, e.g. 'cpus:16;mem:65536|cpus:32;mem:131072'.",
+        "cpus:16;mem:65536;disk:1048576;ports:[31000-32000]");
+
+    add(&SimulatorFlags::cycles,
+        "cycles",
+        "Number of measured allocation cycles.",
+        100);
+
+    add(&SimulatorFlags::cycle_interval,
+        "cycle_interval",
+        "Simulated time between two allocation cycles.",
+        Seconds(1));
+
+    add(&SimulatorFlags::decline_rate,
+        "decline_rate",
+        "Probability in [0, 1] that a framework declines an offer.",
+        0.5);
+
+    add(&SimulatorFlags::refuse_seconds,
+        "refuse_seconds",
+        "Refuse filter installed with every declined offer.",
+        5.0);
+
+    add(&SimulatorFlags::task_cycles,
+        "task_cycles",
+        "Number of cycles accepted resources stay in use.",
+        10);
+
+    add(&SimulatorFlags::churn_rate,
+        "churn_rate",
+        "Fraction of slaves removed and re-added every cycle.",
+        0.0);
+
+    add(&SimulatorFlags::seed,
+        "seed",
+        "Seed for the random number generator.",
+        42);
+
+    add(&SimulatorFlags::state_benchmark,
+        "state_benchmark",
+        "Whether to time streaming the final allocator state as JSON,\n"
+        "as served by the allocator's '/state.json' endpoint.",
+        false);
+
+    add(&SimulatorFlags::failover,
+        "failover",
+        "Whether to fail the allocator over to a fresh one at the end\n"
+        "and time how long it takes until all frameworks and slaves\n"
+        "re-registered and a first allocation cycle completed. Set\n"
+        "'--checkpoint' to have the fresh allocator load a checkpoint\n"
+        "of the previous one.",
+        false);
+
+    add(&SimulatorFlags::bulk_recover,
+        "bulk_recover",
+        "Whether the resources of declined offers and finished tasks are\n"
+        "recovered with one 'bulkRecoverResources' call per cycle rather\n"
+        "than one 'recoverResources' call each.",
+        false);
+
+    add(&SimulatorFlags::idle_frameworks,
+        "idle_frameworks",
+        "Fraction of the frameworks without pending work, which decline\n"
+        "every offer.",
+        0.0);
+
+    add(&SimulatorFlags::suppress,
+        "suppress",
+        "Whether idle frameworks suppress offers, see\n"
+        "'--idle_frameworks'.",
+        false);
+
+    add(&SimulatorFlags::weight_updates,
+        "weight_updates",
+        "Number of cycles after which all roles get new random weights\n"
+        "through 'updateWeights', in between allocations. 0 disables\n"
+        "weight updates.",
+        0);
+
+    add(&SimulatorFlags::quota_roles,
+        "quota_roles",
+        "Number of roles guaranteed '--quota' each, set once the slaves\n"
+        "are added. Reports after how many cycles all quotas are met.",
+        0);
+
+    add(&SimulatorFlags::quota,
+        "quota",
+        "Resources guaranteed to each of the '--quota_roles'.",
+        "cpus:64;mem:262144");
+
+    add(&SimulatorFlags::oversubscription,
+        "oversubscription",
+        "Fraction in [0, 1] of the scalar resources in use on a slave\n"
+        "estimated to be idle every cycle, which the slave reports to\n"
+        "the allocator as revocable through 'updateSlave'. 0 disables\n"
+        "oversubscription.",
+        0.0);
+
+    add(&SimulatorFlags::revocable_frameworks,
+        "revocable_frameworks",
+        "Fraction of the frameworks accepting revocable resources.",
+        0.0);
+
+    add(&SimulatorFlags::task_shapes,
+        "task_shapes",
+        "'|' separated list of task shapes, assigned round-robin to\n"
+        "frameworks, which request them through 'requestResources', e.g.\n"
+        "'cpus:1;mem:1024|cpus:8;mem:32768'. A framework accepting an\n"
+        "offer runs one task of its shape and declines the rest without\n"
+        "a filter, an offer its shape does not fit is declined. Reports\n"
+        "the fragmentation of the free cpus and how many tasks of the\n"
+        "largest shape are placed, see '--placement'. Empty lets\n"
+        "frameworks accept whole offers.",
+        "");
+
+    add(&SimulatorFlags::racks,
+        "racks",
+        "Number of racks the slaves are spread across round-robin, as\n"
+        "their 'rack' attribute. 0 leaves slaves without attributes.",
+        0);
+
+    add(&SimulatorFlags::constrained_frameworks,
+        "constrained_frameworks",
+        "Fraction of the frameworks, chosen at random, that only run\n"
+        "tasks on the slaves of one rack, see '--racks', and decline\n"
+        "offers of other slaves.",
+        0.0);
+
+    add(&SimulatorFlags::constraints,
+        "constraints",
+        "Whether constrained frameworks register their constraint with\n"
+        "the allocator through 'updateConstraints', so that they are\n"
+        "only offered the slaves of their rack.",
+        true);
+  }
+
+  int slaves;
+  int frameworks;
+  int roles;
+  string slave_shapes;
+  int cycles;
+  Duration cycle_interval;
+  double decline_rate;
+  double refuse_seconds;
+  int task_cycles;
+  double churn_rate;
+  int seed;
+  bool state_benchmark;
+  bool failover;
+  bool bulk_recover;
+  double idle_frameworks;
+  bool suppress;
+  int weight_updates;
+  int quota_roles;
+  string quota;
+  double oversubscription;
+  double revocable_frameworks;
+  string task_shapes;
+  int racks;
+  double constrained_frameworks;
+  bool constraints;
+};
+
+
+// The calls the simulator makes on top of 'MesosAllocatorProcess'.
+// They are dispatched through this interface, so that the simulator
+// can drive any of the engines, see 'engines.hpp'.
+class SimulatedAllocator : public virtual process::ProcessBase
+{
+public:
+  virtual ~SimulatedAllocator() {}
+
+  // The same process, for the regular allocator calls.
+  virtual MesosAllocatorProcess* allocator() = 0;
+
+  // Runs a single batch allocation, including publishing the
+  // snapshot, so that it can be timed.
+  virtual Duration cycle() = 0;
+
+  // Number of distinct resources held by slaves and filters.
+  virtual size_t interned() = 0;
+
+  // Checkpoints the allocator state right away, see '--checkpoint'.
+  virtual Duration checkpointState() = 0;
+
+  // Number of slaves of the recovered checkpoint that have not
+  // re-registered yet.
+  virtual size_t unreconciled() = 0;
+
+  // Number of roles whose quota is not met yet.
+  virtual size_t unmetQuotas() = 0;
+
+  virtual std::shared_ptr<const Snapshot> snapshot() const = 0;
+};
+
+
+template <typename RoleSorter, typename FrameworkSorter>
+class SimulatedAllocatorProcess
+  : public HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter>,
+    public SimulatedAllocator
+{
+public:
+  typedef HierarchicalAllocatorProcess<RoleSorter, FrameworkSorter> Base;
+
+  explicit SimulatedAllocatorProcess(const Flags& flags)
+    : ProcessBase(process::ID::generate("hierarchical-allocator")),
+      Base(flags) {}
+
+  MesosAllocatorProcess* allocator()
+  {
+    return this;
+  }
+
+  Duration cycle()
+  {
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    this->allocate(this->slaves.keys());
+    this->publish();
+
+    return stopwatch.elapsed();
+  }
+
+  size_t interned()
+  {
+    return this->resourcesPool.size();
+  }
+
+  Duration checkpointState()
+  {
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    this->writeCheckpoint();
+
+    return stopwatch.elapsed();
+  }
+
+  size_t unreconciled()
+  {
+    return this->recoveredSlaves.size();
+  }
+
+  size_t unmetQuotas()
+  {
+    return this->unmetQuota.size();
+  }
+
+  std::shared_ptr<const Snapshot> snapshot() const
+  {
+    return Base::snapshot();
+  }
+};
+
+
+// Creates the simulated process of the engine selected by the flags.
+typedef engines::ProcessCreator<SimulatedAllocatorProcess, SimulatedAllocator>
+  SimulatedAllocatorCreator;
+
+
+struct SimulatedOffer
+{
+  FrameworkID frameworkId;
+  SlaveID slaveId;
+  Resources resources;
+};
+
+
+// Collects offers made by the allocator. The callback is invoked on
+// the allocator's thread, hence the lock.
+class OfferSink
+{
+public:
+  OfferSink() : total(0), calls(0) {}
+
+  void offer(
+      const FrameworkID& frameworkId,
+      const hashmap<SlaveID, Resources>& resources)
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    foreachpair (const SlaveID& slaveId, const Resources& offered, resources) {
+      SimulatedOffer offer;
+      offer.frameworkId = frameworkId;
+      offer.slaveId = slaveId;
+      offer.resources = offered;
+      pending.push_back(offer);
+    }
+
+    total += resources.size();
+    calls++;
+  }
+
+  vector<SimulatedOffer> drain()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    vector<SimulatedOffer> result;
+    result.swap(pending);
+    return result;
+  }
+
+  uint64_t count()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return total;
+  }
+
+  // Number of offer callbacks, i.e., of messages the master would
+  // send out.
+  uint64_t messages()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    return calls;
+  }
+
+private:
+  std::mutex mutex;
+  vector<SimulatedOffer> pending;
+  uint64_t total;
+  uint64_t calls;
+};
+
+
+// Resources accepted by a framework and held until 'end'.
+struct RunningTask
+{
+  SimulatedOffer offer;
+  int end;
+};
+
+
+// Returns a memory figure of '/proc/self/status', e.g. 'VmRSS'.
+static Option<Bytes> memory(const string& field)
+{
+  Try<string> status = os::read("/proc/self/status");
+  if (status.isError()) {
+    return None();
+  }
+
+  foreach (const string& line, strings::tokenize(status.get(), "\n")) {
+    if (strings::startsWith(line, field + ":")) {
+      vector<string> tokens = strings::tokenize(line, " \t");
+      if (tokens.size() == 3) {
+        Try<uint64_t> kilobytes = numify<uint64_t>(tokens[1]);
+        if (kilobytes.isSome()) {
+          return Kilobytes(kilobytes.get());
+        }
+      }
+    }
+  }
+
+  return None();
+}
+
+
+static Duration percentile(const vector<Duration>& sorted, double p)
+{
+  if (sorted.empty()) {
+    return Duration::zero();
+  }
+
+  size_t index = static_cast<size_t>(p * (sorted.size() - 1) + 0.5);
+  return sorted[std::min(index, sorted.size() - 1)];
+}
+
+
+static bool coin(double probability)
+{
+  return (static_cast<double>(::rand()) / RAND_MAX) < probability;
+}
+
+
+static SlaveInfo createSlaveInfo(const string& hostname, const string& rack)
+{
+  SlaveInfo slaveInfo;
+  slaveInfo.set_hostname(hostname);
+  slaveInfo.set_checkpoint(true);
+
+  if (!rack.empty()) {
+    Attribute* attribute = slaveInfo.add_attributes();
+    attribute->set_name("rack");
+    attribute->set_type(Value::TEXT);
+    attribute->mutable_text()->set_value(rack);
+  }
+
+  return slaveInfo;
+}
+
+
+static FrameworkInfo createFrameworkInfo(
+    const FrameworkID& frameworkId,
+    const string& role,
+    bool revocable)
+{
+  FrameworkInfo frameworkInfo;
+  frameworkInfo.set_user("user");
+  frameworkInfo.set_name(frameworkId.value());
+  frameworkInfo.set_role(role);
+
+  if (revocable) {
+    frameworkInfo.add_capabilities()->set_type(
+        FrameworkInfo::Capability::REVOCABLE_RESOURCES);
+  }
+
+  return frameworkInfo;
+}
+
+
+// The last '--revocable_frameworks' of the frameworks accept
+// revocable resources, so that they do not coincide with the idle
+// ones.
+static bool acceptsRevocable(const SimulatorFlags& flags, int index)
+{
+  return index >= (1 - flags.revocable_frameworks) * flags.frameworks;
+}
+
+
+// Returns the given fraction of the scalar resources, as revocable
+// resources.
+static Resources oversubscribe(const Resources& resources, double fraction)
+{
+  Resources result;
+  foreach (Resource resource, resources.nonRevocable()) {
+    if (resource.type() != Value::SCALAR) {
+      continue;
+    }
+
+    resource.mutable_scalar()->set_value(
+        resource.scalar().value() * fraction);
+    resource.mutable_revocable();
+    result += resource;
+  }
+
+  return result;
+}
+
+
+// Streams the snapshot through a pipe, as '/state.json' does, and
+// reports how long it took and how much memory it took on top of the
+// allocator state.
+static void benchmarkState(const std::shared_ptr<const Snapshot>& snapshot)
+{
+  int fds[2];
+  if (::pipe(fds) == -1) {
+    cerr << "Failed to create pipe: " << strerror(errno) << endl;
+    return;
+  }
+
+  // Reset the peak RSS, so that it reflects the streaming only.
+  os::write("/proc/self/clear_refs", "5");
+
+  Option<Bytes> before = memory("VmRSS");
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  std::thread writer(&state::write, snapshot, fds[1]);
+
+  uint64_t size = 0;
+  char buffer[64 * 1024];
+  ssize_t length;
+  while ((length = ::read(fds[0], buffer, sizeof(buffer))) != 0) {
+    if (length < 0 && errno == EINTR) {
+      continue;
+    } else if (length < 0) {
+      cerr << "Failed to read state: " << strerror(errno) << endl;
+      break;
+    }
+    size += length;
+  }
+
+  writer.join();
+  os::close(fds[0]);
+
+  cout << "  state.json: " << Bytes(size) << " in " << stopwatch.elapsed()
+       << endl;
+
+  Option<Bytes> peak = memory("VmHWM");
+  if (before.isSome() && peak.isSome()) {
+    cout << "  state peak: " << peak.get() << " ("
+         << (peak.get() > before.get()
+               ? peak.get() - before.get() : Bytes(0))
+         << " above RSS)" << endl;
+  }
+}
+
+
+// Replaces the allocator with a fresh one, as a master failover does,
+// and re-registers the frameworks and slaves along with the resources
+// still in use. Reports how long it takes until a first allocation
+// cycle completed. Returns the fresh allocator.
+static SimulatedAllocator* failover(
+    const SimulatorFlags& flags,
+    SimulatedAllocator* process,
+    const hashmap<string, mesos::master::RoleInfo>& roles,
+    const lambda::function<
+        void(const FrameworkID&,
+             const hashmap<SlaveID, Resources>&)>& offerCallback,
+    const hashmap<SlaveID, Resources>& shapeOf,
+    const hashmap<SlaveID, string>& rackOf,
+    const hashmap<FrameworkID, string>& constraintOf,
+    const list<RunningTask>& running)
+{
+  if (flags.checkpoint.isSome()) {
+    Duration elapsed = process::dispatch(
+        PID<SimulatedAllocator>(process),
+        &SimulatedAllocator::checkpointState).get();
+
+    cout << "  checkpoint: " << elapsed << endl;
+  }
+
+  process::terminate(process);
+  process::wait(process);
+  delete process;
+
+  // Outstanding offers are rescinded by the failover, only the
+  // resources in use are re-registered. Like the master, they are
+  // re-registered along with the slaves: frameworks re-register
+  // first, hence none of their slaves are known yet.
+  hashmap<SlaveID, hashmap<FrameworkID, Resources> > usedBySlave;
+  foreach (const RunningTask& task, running) {
+    usedBySlave[task.offer.slaveId][task.offer.frameworkId] +=
+      task.offer.resources;
+  }
+
+  Stopwatch stopwatch;
+  stopwatch.start();
+
+  // The flags were validated when the first process was created.
+  process = engines::create<SimulatedAllocatorCreator>(flags).get();
+  process::spawn(process);
+
+  MesosAllocatorProcess* allocator = process->allocator();
+
+  process::dispatch(
+      allocator,
+      &MesosAllocatorProcess::initialize,
+      Days(365),
+      offerCallback,
+      roles);
+
+  for (int i = 0; i < flags.frameworks; i++) {
+    FrameworkID frameworkId;
+    frameworkId.set_value("framework" + stringify(i));
+
+    process::dispatch(
+        allocator,
+        &MesosAllocatorProcess::addFramework,
+        frameworkId,
+        createFrameworkInfo(
+            frameworkId,
+            "role" + stringify(i % flags.roles),
+            acceptsRevocable(flags, i)),
+        hashmap<SlaveID, Resources>());
+
+    if (flags.constraints && constraintOf.contains(frameworkId)) {
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::updateConstraints,
+          frameworkId,
+          "rack:" + constraintOf.get(frameworkId).get());
+    }
+  }
+
+  foreachpair (const SlaveID& slaveId, const Resources& total, shapeOf) {
+    process::dispatch(
+        allocator,
+        &MesosAllocatorProcess::addSlave,
+        slaveId,
+        createSlaveInfo(slaveId.value(), rackOf.get(slaveId).getOrElse("")),
+        total,
+        usedBySlave.get(slaveId).getOrElse(hashmap<FrameworkID, Resources>()));
+  }
+
+  Duration cycle = process::dispatch(
+      PID<SimulatedAllocator>(process),
+      &SimulatedAllocator::cycle).get();
+
+  cout << "Failed over in " << stopwatch.elapsed()
+       << (flags.checkpoint.isSome() ? " with" : " without")
+       << " checkpoint" << endl
+       << "  cycle:        " << cycle << endl;
+
+  if (flags.checkpoint.isSome()) {
+    cout << "  unreconciled: "
+         << process::dispatch(
+                PID<SimulatedAllocator>(process),
+                &SimulatedAllocator::unreconciled).get()
+         << " slaves" << endl;
+  }
+
+  return process;
+}
+
+
+static void usage(const char* argv0, const flags::FlagsBase& flags)
+{
+  cerr << "Usage: " << os::basename(argv0).get() << " [...]" << endl
+       << endl
+       << "Supported options:" << endl
+       << flags.usage();
+}
+
+
+int main(int argc, char** argv)
+{
+  SimulatorFlags flags;
+
+  Try<Nothing> load = flags.load(None(), argc, argv);
+  if (load.isError()) {
+    cerr << load.error() << endl;
+    usage(argv[0], flags);
+    return EXIT_FAILURE;
+  }
+
+  if (flags.slaves <= 0 || flags.frameworks <= 0 || flags.roles <= 0) {
+    cerr << "--slaves, --frameworks and --roles must be positive" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (flags.oversubscription < 0 || flags.oversubscription > 1 ||
+      flags.revocable_frameworks < 0 || flags.revocable_frameworks > 1) {
+    cerr << "--oversubscription and --revocable_frameworks must be in "
+         << "[0, 1]" << endl;
+    return EXIT_FAILURE;
+  }
+
+  if (flags.quota_roles < 0 || flags.quota_roles > flags.roles) {
+    cerr << "--quota_roles must be between 0 and --roles" << endl;
+    return EXIT_FAILURE;
+  }
+
+  Try<Resources> quota = Resources::parse(flags.quota);
+  if (quota.isError()) {
+    cerr << "Failed to parse --quota: " << quota.error() << endl;
+    return EXIT_FAILURE;
+  }
+
+  vector<Resources> shapes;
+  foreach (const string& shape, strings::tokenize(flags.slave_shapes, "|")) {
+    Try<Resources> resources = Resources::parse(shape);
+    if (resources.isError()) {
+      cerr << "Failed to parse slave shape '" << shape << "': "
+           << resources.error() << endl;
+      return EXIT_FAILURE;
+    }
+    shapes.push_back(resources.get());
+  }
+
+  if (shapes.empty()) {
+    cerr << "--slave_shapes must contain at least one shape" << endl;
+    return EXIT_FAILURE;
+  }
+
+  vector<Resources> taskShapes;
+  foreach (const string& shape, strings::tokenize(flags.task_shapes, "|")) {
+    Try<Resources> resources = Resources::parse(shape);
+    if (resources.isError()) {
+      cerr << "Failed to parse task shape '" << shape << "': "
+           << resources.error() << endl;
+      return EXIT_FAILURE;
+    }
+    taskShapes.push_back(resources.get());
+  }
+
+  // The shape with the most cpus counts as the large one.
+  size_t largest = 0;
+  for (size_t i = 1; i < taskShapes.size(); i++) {
+    if (taskShapes[i].cpus().getOrElse(0.0) >
+        taskShapes[largest].cpus().getOrElse(0.0)) {
+      largest = i;
+    }
+  }
+
+  ::srand(flags.seed);
+
+  Option<Bytes> baseline = memory("VmRSS");
+
+  Clock::pause();
+
+  Try<SimulatedAllocator*> created =
+    engines::create<SimulatedAllocatorCreator>(flags);
+
+  if (created.isError()) {
+    cerr << created.error() << endl;
+    usage(argv[0], flags);
+    return EXIT_FAILURE;
+  }
+
+  SimulatedAllocator* process = created.get();
+  process::spawn(process);
+
+  MesosAllocatorProcess* allocator = process->allocator();
+  PID<SimulatedAllocator> pid(process);
+
+  cout << "Simulating allocator engine '" << engines::name(flags) << "'"
+       << endl;
+
+  OfferSink sink;
+
+  hashmap<string, mesos::master::RoleInfo> roles;
+  for (int i = 0; i < flags.roles; i++) {
+    mesos::master::RoleInfo roleInfo;
+    roleInfo.set_name("role" + stringify(i));
+    roleInfo.set_weight(1.0);
+    roles[roleInfo.name()] = roleInfo;
+  }
+
+  lambda::function<
+      void(const FrameworkID&,
+           const hashmap<SlaveID, Resources>&)> offerCallback =
+    lambda::bind(&OfferSink::offer, &sink, lambda::_1, lambda::_2);
+
+  // Allocation is driven explicitly, keep the batch timer out of
+  // the way.
+  process::dispatch(
+      allocator,
+      &MesosAllocatorProcess::initialize,
+      Days(365),
+      offerCallback,
+      roles);
+
+  hashset<FrameworkID> idle;
+
+  // Index of each framework's shape in 'taskShapes', if any.
+  hashmap<FrameworkID, size_t> taskShapeOf;
+
+  // The rack of each constrained framework, see '--racks'.
+  hashmap<FrameworkID, string> constraintOf;
+
+  for (int i = 0; i < flags.frameworks; i++) {
+    FrameworkID frameworkId;
+    frameworkId.set_value("framework" + stringify(i));
+
+    process::dispatch(
+        allocator,
+        &MesosAllocatorProcess::addFramework,
+        frameworkId,
+        createFrameworkInfo(
+            frameworkId,
+            "role" + stringify(i % flags.roles),
+            acceptsRevocable(flags, i)),
+        hashmap<SlaveID, Resources>());
+
+    if (flags.racks > 0 && coin(flags.constrained_frameworks)) {
+      constraintOf[frameworkId] = "r" + stringify(i % flags.racks);
+
+      if (flags.constraints) {
+        process::dispatch(
+            allocator,
+            &MesosAllocatorProcess::updateConstraints,
+            frameworkId,
+            "rack:" + constraintOf[frameworkId]);
+      }
+    }
+
+    if (!taskShapes.empty()) {
+      taskShapeOf[frameworkId] = i % taskShapes.size();
+
+      Request request;
+      request.mutable_resources()->CopyFrom(
+          taskShapes[taskShapeOf[frameworkId]]);
+
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::requestResources,
+          frameworkId,
+          vector<Request>(1, request));
+    }
+
+    if (i < flags.idle_frameworks * flags.frameworks) {
+      idle.insert(frameworkId);
+
+      if (flags.suppress) {
+        process::dispatch(
+            allocator,
+            &MesosAllocatorProcess::suppressOffers,
+            frameworkId);
+      }
+    }
+  }
+
+  // Slave IDs are never reused, so that churned slaves look new.
+  int nextSlave = 0;
+  vector<SlaveID> slaves;
+  hashmap<SlaveID, Resources> shapeOf;
+  hashmap<SlaveID, string> rackOf;
+
+  Stopwatch setup;
+  setup.start();
+
+  for (int i = 0; i < flags.slaves; i++) {
+    SlaveID slaveId;
+    slaveId.set_value("slave" + stringify(nextSlave++));
+
+    const Resources& total = shapes[i % shapes.size()];
+
+    if (flags.racks > 0) {
+      rackOf[slaveId] = "r" + stringify(i % flags.racks);
+    }
+
+    process::dispatch(
+        allocator,
+        &MesosAllocatorProcess::addSlave,
+        slaveId,
+        createSlaveInfo(slaveId.value(), rackOf.get(slaveId).getOrElse("")),
+        total,
+        hashmap<FrameworkID, Resources>());
+
+    slaves.push_back(slaveId);
+    shapeOf[slaveId] = total;
+  }
+
+  Clock::settle();
+
+  cout << "Added " << flags.slaves << " slaves and " << flags.frameworks
+       << " frameworks in " << setup.elapsed() << endl;
+
+  for (int i = 0; i < flags.quota_roles; i++) {
+    process::dispatch(
+        allocator,
+        &MesosAllocatorProcess::setQuota,
+        "role" + stringify(i),
+        quota.get());
+  }
+
+  Clock::settle();
+
+  // The number of cycles after which all quotas were met.
+  Option<int> quotaMet;
+
+  list<RunningTask> running;
+  vector<Duration> latencies;
+  uint64_t offersBefore = sink.count();
+  uint64_t messagesBefore = sink.messages();
+  uint64_t offered = 0; // Sum of the frameworks offered to per cycle.
+  uint64_t declined = 0;
+  uint64_t accepted = 0;
+
+  uint64_t recoveries = 0;
+  Duration recoveryTime = Duration::zero();
+
+  vector<Duration> weightUpdates;
+
+  // Cpus of the cluster and the sums of the cpus in use, regular and
+  // revocable, sampled once per cycle.
+  double totalCpus = 0.0;
+  foreachvalue (const Resources& total, shapeOf) {
+    totalCpus += total.cpus().getOrElse(0.0);
+  }
+
+  double usedCpus = 0.0;
+  double usedRevocableCpus = 0.0;
+
+  // Sum of the fractions of the free cpus on slaves that cannot fit a
+  // task of the largest shape, sampled once per cycle, see
+  // '--task_shapes'.
+  double fragmentation = 0.0;
+  uint64_t largePlaced = 0;
+  uint64_t unfit = 0;
+
+  // Offers declined by constrained frameworks for the slave's rack.
+  uint64_t unmatched = 0;
+
+  Filters filters;
+  filters.set_refuse_seconds(flags.refuse_seconds);
+
+  for (int cycle = 0; cycle < flags.cycles; cycle++) {
+    vector<RecoveredResources> recovered;
+
+    // Respond to the offers made since the previous cycle.
+    hashset<FrameworkID> offered_;
+    foreach (const SimulatedOffer& offer, sink.drain()) {
+      offered_.insert(offer.frameworkId);
+
+      const bool fits = !taskShapeOf.contains(offer.frameworkId) ||
+        offer.resources.contains(
+            taskShapes[taskShapeOf[offer.frameworkId]]);
+
+      if (!fits) {
+        unfit++;
+      }
+
+      const bool matches = !constraintOf.contains(offer.frameworkId) ||
+        rackOf.get(offer.slaveId) == constraintOf[offer.frameworkId];
+
+      if (!matches) {
+        unmatched++;
+      }
+
+      if (!fits ||
+          !matches ||
+          idle.contains(offer.frameworkId) ||
+          coin(flags.decline_rate)) {
+        RecoveredResources recovered_;
+        recovered_.frameworkId = offer.frameworkId;
+        recovered_.slaveId = offer.slaveId;
+        recovered_.resources = offer.resources;
+        recovered_.filters = filters;
+        recovered.push_back(recovered_);
+        declined++;
+      } else if (taskShapeOf.contains(offer.frameworkId)) {
+        // Run one task of the framework's shape, the rest of the
+        // offer is declined right away.
+        const Resources& shape = taskShapes[taskShapeOf[offer.frameworkId]];
+
+        RecoveredResources recovered_;
+        recovered_.frameworkId = offer.frameworkId;
+        recovered_.slaveId = offer.slaveId;
+        recovered_.resources = offer.resources - shape;
+        recovered.push_back(recovered_);
+
+        RunningTask task;
+        task.offer = offer;
+        task.offer.resources = shape;
+        task.end = cycle + flags.task_cycles;
+        running.push_back(task);
+        accepted++;
+
+        if (taskShapeOf[offer.frameworkId] == largest) {
+          largePlaced++;
+        }
+      } else {
+        RunningTask task;
+        task.offer = offer;
+        task.end = cycle + flags.task_cycles;
+        running.push_back(task);
+        accepted++;
+      }
+    }
+
+    offered += offered_.size();
+
+    foreach (const RunningTask& task, running) {
+      usedCpus += task.offer.resources.nonRevocable().cpus().getOrElse(0.0);
+      usedRevocableCpus +=
+        task.offer.resources.revocable().cpus().getOrElse(0.0);
+    }
+
+    if (!taskShapes.empty()) {
+      hashmap<SlaveID, Resources> inUse;
+      foreach (const RunningTask& task, running) {
+        inUse[task.offer.slaveId] += task.offer.resources.nonRevocable();
+      }
+
+      double free = 0.0;
+      double fragmented = 0.0;
+      foreachpair (const SlaveID& slaveId, const Resources& total, shapeOf) {
+        const Resources available =
+          total - inUse.get(slaveId).getOrElse(Resources());
+        const double cpus = available.cpus().getOrElse(0.0);
+
+        free += cpus;
+        if (!available.contains(taskShapes[largest])) {
+          fragmented += cpus;
+        }
+      }
+
+      if (free > 0) {
+        fragmentation += fragmented / free;
+      }
+    }
+
+    // Finish tasks whose time is up.
+    for (list<RunningTask>::iterator it = running.begin(); it != running.end();) {
+      if (it->end <= cycle) {
+        RecoveredResources recovered_;
+        recovered_.frameworkId = it->offer.frameworkId;
+        recovered_.slaveId = it->offer.slaveId;
+        recovered_.resources = it->offer.resources;
+        recovered.push_back(recovered_);
+        it = running.erase(it);
+      } else {
+        ++it;
+      }
+    }
+
+    // Time how long the allocator takes to process the recoveries.
+    Stopwatch stopwatch;
+    stopwatch.start();
+
+    if (flags.bulk_recover) {
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::bulkRecoverResources,
+          recovered);
+    } else {
+      foreach (const RecoveredResources& recovered_, recovered) {
+        process::dispatch(
+            allocator,
+            &MesosAllocatorProcess::recoverResources,
+            recovered_.frameworkId,
+            recovered_.slaveId,
+            recovered_.resources,
+            recovered_.filters);
+      }
+    }
+
+    Clock::settle();
+
+    recoveryTime += stopwatch.elapsed();
+    recoveries += recovered.size();
+
+    // Time how long the allocator takes to apply new weights to all
+    // roles.
+    if (flags.weight_updates > 0 && (cycle + 1) % flags.weight_updates == 0) {
+      vector<mesos::master::RoleInfo> roleInfos;
+      foreachvalue (const mesos::master::RoleInfo& roleInfo, roles) {
+        roleInfos.push_back(roleInfo);
+        roleInfos.back().set_weight(1 + ::rand() % 10);
+      }
+
+      stopwatch.start();
+
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::updateWeights,
+          roleInfos);
+
+      Clock::settle();
+
+      weightUpdates.push_back(stopwatch.elapsed());
+    }
+
+    // Replace a fraction of the slaves with fresh ones. The tasks
+    // running on a removed slave are lost, as the master would do.
+    int churn = static_cast<int>(flags.churn_rate * slaves.size());
+    for (int i = 0; i < churn; i++) {
+      size_t index = ::rand() % slaves.size();
+      SlaveID removed = slaves[index];
+
+      for (list<RunningTask>::iterator it = running.begin(); it != running.end();) {
+        if (it->offer.slaveId == removed) {
+          process::dispatch(
+              allocator,
+              &MesosAllocatorProcess::recoverResources,
+              it->offer.frameworkId,
+              it->offer.slaveId,
+              it->offer.resources,
+              None());
+          it = running.erase(it);
+        } else {
+          ++it;
+        }
+      }
+
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::removeSlave,
+          removed);
+
+      SlaveID slaveId;
+      slaveId.set_value("slave" + stringify(nextSlave++));
+
+      Resources total = shapeOf[removed];
+      shapeOf.erase(removed);
+
+      // The fresh slave takes the place of the removed one, in its
+      // rack.
+      const string rack = rackOf.get(removed).getOrElse("");
+      rackOf.erase(removed);
+
+      process::dispatch(
+          allocator,
+          &MesosAllocatorProcess::addSlave,
+          slaveId,
+          createSlaveInfo(slaveId.value(), rack),
+          total,
+          hashmap<FrameworkID, Resources>());
+
+      slaves[index] = slaveId;
+      shapeOf[slaveId] = total;
+
+      if (!rack.empty()) {
+        rackOf[slaveId] = rack;
+      }
+    }
+
+    // Estimate the idle share of the resources in use on every slave,
+    // as a resource estimator would.
+    if (flags.oversubscription > 0) {
+      hashmap<SlaveID, Resources> inUse;
+      foreach (const RunningTask& task, running) {
+        inUse[task.offer.slaveId] += task.offer.resources.nonRevocable();
+      }
+
+      foreach (const SlaveID& slaveId, slaves) {
+        process::dispatch(
+            allocator,
+            &MesosAllocatorProcess::updateSlave,
+            slaveId,
+            oversubscribe(
+                inUse.get(slaveId).getOrElse(Resources()),
+                flags.oversubscription));
+      }
+    }
+
+    Clock::advance(flags.cycle_interval);
+    Clock::settle();
+
+    latencies.push_back(
+        process::dispatch(pid, &SimulatedAllocator::cycle).get());
+
+    if (flags.quota_roles > 0 &&
+        quotaMet.isNone() &&
+        process::dispatch(pid, &SimulatedAllocator::unmetQuotas)
+          .get() == 0) {
+      quotaMet = cycle + 1;
+    }
+  }
+
+  uint64_t offers = sink.count() - offersBefore;
+  uint64_t messages = sink.messages() - messagesBefore;
+
+  Duration elapsed = Duration::zero();
+  foreach (const Duration& latency, latencies) {
+    elapsed += latency;
+  }
+
+  std::sort(latencies.begin(), latencies.end());
+
+  cout << "Ran " << latencies.size() << " cycles in " << elapsed << endl
+       << "  cycle p50:  " << percentile(latencies, 0.50) << endl
+       << "  cycle p90:  " << percentile(latencies, 0.90) << endl
+       << "  cycle p99:  " << percentile(latencies, 0.99) << endl
+       << "  cycle max:  " << percentile(latencies, 1.00) << endl
+       << "  offers:     " << offers << " (" << accepted << " accepted, "
+       << declined << " declined) in " << messages << " messages" << endl;
+
+  if (!latencies.empty()) {
+    cout << "  offered:    " << std::fixed << std::setprecision(1)
+         << offered / static_cast<double>(latencies.size())
+         << " frameworks per cycle" << endl;
+  }
+
+  if (elapsed > Duration::zero()) {
+    cout << "  offers/s:   " << std::fixed << std::setprecision(0)
+         << offers / elapsed.secs() << endl;
+  }
+
+  cout << "  recovered:  " << recoveries << " in " << recoveryTime;
+  if (recoveryTime > Duration::zero()) {
+    cout << " (" << std::fixed << std::setprecision(0)
+         << recoveries / recoveryTime.secs() << "/s"
+         << (flags.bulk_recover ? ", in bulk" : "") << ")";
+  }
+  cout << endl;
+
+  if (flags.quota_roles > 0) {
+    cout << "  quota:      " << flags.quota_roles << " roles, ";
+    if (quotaMet.isSome()) {
+      cout << "met after " << quotaMet.get() << " cycles ("
+           << flags.cycle_interval * quotaMet.get() << " simulated)";
+    } else {
+      cout << process::dispatch(pid, &SimulatedAllocator::unmetQuotas)
+                .get()
+           << " still unmet";
+    }
+    cout << endl;
+  }
+
+  if (!latencies.empty() && totalCpus > 0) {
+    const double samples = totalCpus * latencies.size();
+
+    cout << "  cpus used:  " << std::fixed << std::setprecision(1)
+         << 100 * (usedCpus + usedRevocableCpus) / samples << "% on average ("
+         << 100 * usedRevocableCpus / samples << "% revocable)" << endl;
+  }
+
+  if (!latencies.empty() && !taskShapes.empty()) {
+    cout << "  fragments:  " << std::fixed << std::setprecision(1)
+         << 100 * fragmentation / latencies.size()
+         << "% of the free cpus on average cannot fit "
+         << taskShapes[largest] << endl
+         << "  large:      " << largePlaced << " tasks placed ("
+         << std::setprecision(2)
+         << largePlaced / static_cast<double>(latencies.size())
+         << " per cycle), " << unfit << " offers did not fit" << endl;
+  }
+
+  if (!constraintOf.empty()) {
+    cout << "  constraints: " << constraintOf.size() << " frameworks "
+         << (flags.constraints ? "registered" : "unregistered") << ", "
+         << unmatched << " offers declined for their rack" << endl;
+  }
+
+  if (!weightUpdates.empty()) {
+    std::sort(weightUpdates.begin(), weightUpdates.end());
+
+    cout << "  weights:    " << weightUpdates.size() << " updates of "
+         << roles.size() << " roles, p50 " << percentile(weightUpdates, 0.50)
+         << ", max " << percentile(weightUpdates, 1.00) << endl;
+  }
+
+  // Read without going through the allocator process.
+  std::shared_ptr<const Snapshot> snapshot = process->snapshot();
+  cout << "  snapshot:   epoch " << snapshot->epoch << " with "
+       << snapshot->slaves.size() << " slaves, "
+       << snapshot->frameworks.size() << " frameworks" << endl;
+
+  cout << "  interned:   "
+       << process::dispatch(pid, &SimulatedAllocator::interned).get()
+       << " distinct resources" << endl;
+
+  if (flags.state_benchmark) {
+    benchmarkState(snapshot);
+  }
+
+  if (flags.failover) {
+    process = failover(
+        flags,
+        process,
+        roles,
+        offerCallback,
+        shapeOf,
+        rackOf,
+        constraintOf,
+        running);
+  }
+
+  Option<Bytes> current = memory("VmRSS");
+  if (current.isSome()) {
+    cout << "  rss:        " << current.get();
+    if (baseline.isSome() && current.get() > baseline.get()) {
+      cout << " (" << current.get() - baseline.get() << " since start)";
+    }
+    cout << endl;
+  }
+
+  process::terminate(process);
+  process::wait(process);
+  delete process;
+
+  Clock::resume();
+
+  return EXIT_SUCCESS;
+}